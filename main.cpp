@@ -2,1484 +2,8485 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cctype>
+#include <string_view>
+#include <type_traits>
+#include <mutex>
+#include <condition_variable>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <random>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef FLOW_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef FLOW_BENCH
 #include <regex>
+#endif
 
 
-// Generic Step class template
-class Step {
-private:
-    // Stores the number of errors for each screen, no step has more than 3 screens
-    int errors[3] = {0, 0, 0};
-    int skips = 0; // Keeps track of the skips
+// Why an answer couldn't be read as a number
+enum class ParseError : uint8_t {
+    None,
+    Empty,
+    NotANumber,
+    OutOfRange
+};
 
-protected:
-    // Displays the contents of a file
-    void displayContentsOfFile(std::string name) {
-        std::ifstream file(name);
-        if (!file.is_open()) {
-            std::cout << "Error opening file: " << name << "\n";
-            return;
-        }
-        
-        std::string line;
-        while (std::getline(file, line)) {
-            std::cout << line << "\n";
-        }
+
+// Drops the spaces around an answer
+std::string_view trimAnswer(std::string_view text) {
+    size_t start = text.find_first_not_of(" \t\r");
+    if (start == std::string_view::npos) {
+        return std::string_view();
     }
+    return text.substr(start, text.find_last_not_of(" \t\r") + 1 - start);
+}
 
-    void addContentsFromFirstFileToSecond(std::string first, std::string second) {
-        std::ifstream file(first); // Open for reading
-        if (!file.is_open()) {
-            std::cout << "Error opening file: " << first << "\n";
-            return;
-        }
-        
-        std::ofstream file2(second, std::ios::app); // Open for appending
-        if (!file2.is_open()) {
-            std::cout << "Error opening file: " << second << "\n";
-            return;
-        }
-        
-        std::string line;
-        while (std::getline(file, line)) {
-            file2 << line << "\n";
-        }
 
-        file.close();
-        file2.close();
+// Reads a whole answer as a number, without throwing, allocating or looking at the locale
+// Surrounding spaces and a leading '+' are accepted, anything else around the number is not
+template <typename T>
+ParseError parseNumber(std::string_view text, T& value) {
+    text = trimAnswer(text);
+    if (text.empty()) {
+        return ParseError::Empty;
+    }
+    const char* first = text.data();
+    const char* last = text.data() + text.size();
+    if (*first == '+' && last - first > 1 && first[1] != '-') {
+        first++; // from_chars only accepts the minus sign
     }
 
-public:
-    // Add an error at a given screen (index)
-    void addErrorAtIndex(int index) {
-        errors[index] += 1;
+    std::from_chars_result parsed = std::from_chars(first, last, value);
+    if (parsed.ec == std::errc::result_out_of_range) {
+        return ParseError::OutOfRange;
+    }
+    if (parsed.ec != std::errc() || parsed.ptr != last) {
+        return ParseError::NotANumber;
     }
+    if constexpr (std::is_floating_point_v<T>) {
+        if (!std::isfinite(value)) { // nan and inf are not numbers a step can work with
+            return ParseError::NotANumber;
+        }
+    }
+    return ParseError::None;
+}
 
 
-    // Add a skip
-    void addSkip() {
-        skips += 1;
-    }
+// A fixed point number with 4 decimals, kept as a count of ten thousandths
+// so that amounts add up and compare exactly
+struct Decimal {
+    static const int64_t scale = 10000;
+    static const size_t digits = 4;
 
+    int64_t units = 0;
 
-    // Returns the number of errors at a given screen (index)
-    int getErrorsAtIndex(int index) {
-        return errors[index];
+
+    bool operator==(Decimal other) const {
+        return units == other.units;
     }
 
 
-    // Returns the total number of errors
-    int totalErrors() {
-        return errors[0] + errors[1] + errors[2];
+    bool operator<(Decimal other) const {
+        return units < other.units;
     }
+};
 
 
-    // Returns the number of skips
-    int getSkips() {
-        return skips;
+// Reads a decimal number with at most 4 digits after the point, digit by digit so nothing is rounded
+ParseError parseNumber(std::string_view text, Decimal& value) {
+    text = trimAnswer(text);
+    if (text.empty()) {
+        return ParseError::Empty;
+    }
+    bool negative = text[0] == '-';
+    if (text[0] == '-' || text[0] == '+') {
+        text.remove_prefix(1);
     }
 
+    size_t point = text.find('.');
+    std::string_view whole = text.substr(0, point);
+    std::string_view fraction = point == std::string_view::npos ? std::string_view() : text.substr(point + 1);
+    if ((whole.empty() && fraction.empty()) || fraction.size() > Decimal::digits) {
+        return ParseError::NotANumber;
+    }
 
-    // Displays the number of errors for each screen
-    void displayErrors() {
-        for (int i = 0; i < 3; i++) {
-            std::cout << "Errors on screen " << i + 1 << ": " << errors[i] << "\n";
+    int64_t units = 0;
+    for (size_t i = 0; i < whole.size() + Decimal::digits; i++) {
+        char c = i < whole.size() ? whole[i] : (i - whole.size() < fraction.size() ? fraction[i - whole.size()] : '0');
+        if (c < '0' || c > '9') {
+            return ParseError::NotANumber;
+        }
+        if (__builtin_mul_overflow(units, 10, &units) || __builtin_add_overflow(units, c - '0', &units)) {
+            return ParseError::OutOfRange;
         }
     }
+    value.units = negative ? -units : units;
+    return ParseError::None;
+}
 
 
-    // Virtual functions overriden by the child classes
-    virtual void execute() = 0;
-    virtual std::string getStepName() = 0;
-    virtual void displayInfoOnScreen() = 0;
-    virtual void addInfoToFile(std::string name) = 0;
-};
+// Returns a number as text, the shortest form that reads back as the same value
+template <typename T>
+std::string formatNumber(T value) {
+    char text[64];
+    return std::string(text, std::to_chars(text, text + sizeof(text), value).ptr);
+}
 
 
-// Stores all steps of the current flow
-std::vector<Step*> currentFlowSteps;
+// Returns a decimal as text, without the trailing zeros of its fraction
+std::string formatNumber(Decimal value) {
+    uint64_t units = value.units < 0 ? 0 - static_cast<uint64_t>(value.units) : value.units;
+    std::string text = value.units < 0 ? "-" : "";
+    text += std::to_string(units / Decimal::scale);
 
+    uint64_t fraction = units % Decimal::scale;
+    if (fraction != 0) {
+        char digits[Decimal::digits + 1] = {};
+        for (size_t i = Decimal::digits; i > 0; i--) {
+            digits[i - 1] = '0' + fraction % 10;
+            fraction /= 10;
+        }
+        size_t length = Decimal::digits;
+        while (digits[length - 1] == '0') {
+            length--;
+        }
+        text += '.';
+        text.append(digits, length);
+    }
+    return text;
+}
 
-// Clears all steps of the current flow
-void clearCurrentSteps();
 
+// Writes a decimal without the trailing zeros of its fraction
+std::ostream& operator<<(std::ostream& out, Decimal value) {
+    return out << formatNumber(value);
+}
 
-// TitleStep class
-// Title and subtitle are inputted when the object is created
-class TitleStep : public Step {
-private:
-    std::string title = "NO TITLE";
-    std::string subtitle = "NO SUBTITLE";
 
-public:
-    TitleStep(std::string title, std::string subtitle) : title(title), subtitle(subtitle) {}
+// Reads an answer to a menu with count options numbered from 1 and turns it into an index
+ParseError parseChoice(std::string_view text, size_t count, size_t& index) {
+    size_t choice;
+    ParseError error = parseNumber(text, choice);
+    if (error != ParseError::None) {
+        return error;
+    }
+    if (choice < 1 || choice > count) {
+        return ParseError::OutOfRange;
+    }
+    index = choice - 1;
+    return ParseError::None;
+}
 
-    TitleStep() { // Default constructor
-        std::cout << "---------------------------\n";
-        std::cout << "Creating title step:\n";
 
-        // Get the title
-        std::cout << "Title: ";
-        std::string title;
-        getline(std::cin, title);
+// Where the steps read their answers from and write their prompts to
+class StepIO {
+public:
+    virtual ~StepIO() {}
 
-        // Get the subtitle
-        std::cout << "Subtitle: ";
-        std::string subtitle;
-        getline(std::cin, subtitle);
+    // Reads the next answer, works like getline
+    virtual bool readLine(std::string& line) = 0;
 
-        // Assign the input to it's respective field
-        this->title = title;
-        this->subtitle = subtitle;
-    }
+    // Returns the stream the menus and prompts are written to
+    virtual std::ostream& out() = 0;
+};
 
 
-    // Returns the title
-    std::string getTitle() {
-        return title;
+// Interactive mode, answers are typed by the user and everything is printed
+class ConsoleIO : public StepIO {
+public:
+    bool readLine(std::string& line) override {
+        return static_cast<bool>(getline(std::cin, line));
     }
 
 
-    // Returns the name of the step
-    std::string getStepName() override {
-        return "Title Step";
+    std::ostream& out() override {
+        return std::cout;
     }
+};
 
 
-    // Setter for the subtitle
-    void setSubtitle(std::string subtitle) {
-        this->subtitle = subtitle;
-    }
+// Headless mode, answers come from a script and nothing is rendered
+class ScriptedIO : public StepIO {
+private:
+    const std::vector<std::string>& answers;
+    size_t next = 0; // Index of the next answer to be given
+    std::ostream silent{nullptr}; // A stream without a buffer drops everything written to it
 
+public:
+    ScriptedIO(const std::vector<std::string>& answers) : answers(answers) {}
 
-    // Setter for the title
-    void setTitle(std::string title) {
-        this->title = title;
-    }
 
+    // Every step loops until it gets a valid answer, so running out of answers has to stop the run
+    bool readLine(std::string& line) override {
+        if (next >= answers.size()) {
+            throw std::runtime_error("The answer script ran out of answers");
+        }
 
-    // Displays the title and subtitle on the screen
-    void displayInfoOnScreen() override {
-        std::cout << "Title Step -> Title: " << title << ", Subtitle: " << subtitle << "\n";
+        line = answers[next++];
+        return true;
     }
 
 
-    // Called inside the output step
-    void addInfoToFile(std::string name) override {
-        std::ofstream file(name, std::ios::app); // Open the file in append mode
-        if (!file.is_open()) {
-            file << "Error opening file: " << name << "\n";
-            return;
-        }
-        
-        file << "---------------------------\n";
-        file << "Title Step:\n";
-        file << "Title: " << title << "\n";
-        file << "Subtitle: " << subtitle << "\n";
-        file.close();
+    std::ostream& out() override {
+        return silent;
     }
 
 
-    // Main function that gets called when the step is executed
-    void execute() override {
-        std::string choice;
-
-        // The user can't continue unless he either completes the step
-        // or skips it
-        while (true) {
-            // Display available options
-            std::cout << "---------------------------\n";
-            std::cout << "Executing Title Step:\n";
-            std::cout << "1. Run this step\n";
-            std::cout << "2. Skip this step\n";
-            std::cout << "Enter your choice: ";
-            getline(std::cin, choice);
-            if (choice == "1") { // Run the step
-                // Ask the user to input the title and subtitle
-                std::cout << "---------------------------\n";
-                std::cout << "Running Title Step:\n";
-                std::cout << "Title: " << title << "\n";
-                std::cout << "Subtitle: " << subtitle << "\n";
-
-                break; // Exit and continue to the next step
-            } else if (choice == "2") { // Skip the step
-                std::cout << "Skipping this Title Step...\n";
-                addSkip();
-                break; // Exit and continue with the next step
-            } else { // Invalid choice
-                std::cout << "Invalid choice! Please try again.\n";
-                addErrorAtIndex(0); // Error on the first screen
-            }
-        }
+    // Returns how many answers were consumed so far
+    size_t getAnswersUsed() {
+        return next;
     }
 };
 
 
-// TextStep class
-// Both title and copy are inputted when the object is created
-class TextStep : public Step {
+// Limits how many files are open for reading at the same time
+// A file is only open while it is being mapped, and when many runs do that at once the ones over
+// the limit wait for a descriptor to be given back instead of failing because the process ran out
+class DescriptorPool {
 private:
-    // Couln't decide what copy was supposed to be, so it's just an input string
-    std::string title;
-    std::string copy;
+    std::mutex mutex;
+    std::condition_variable returned;
+    size_t available;
 
 public:
-    TextStep(std::string title, std::string copy) : title(title), copy(copy) {}
-    TextStep(std::string title) : title(title), copy("NO COPY") {}
-    TextStep() {
-        // Ask the user to input the title
-        std::cout << "---------------------------\n";
-        std::cout << "Creaging text step:\n";
+    DescriptorPool(size_t limit) : available(limit) {}
 
-        // Get the title
-        std::cout << "Text Title: ";
-        std::string title;
-        getline(std::cin, title);
-        
-        // Get the copy (just some string text)
-        std::cout << "Text Copy: ";
-        std::string copy;
-        getline(std::cin, copy);
 
-        // Assign the input to it's respective field
-        this->title = title;
-        this->copy = copy;
+    // Returns the pool every reader uses, it takes half the descriptors the process may open
+    static DescriptorPool& shared() {
+        static DescriptorPool pool([] {
+            struct rlimit limit;
+            if (getrlimit(RLIMIT_NOFILE, &limit) < 0 || limit.rlim_cur == RLIM_INFINITY) {
+                return size_t(512);
+            }
+            return std::max(size_t(16), size_t(limit.rlim_cur / 2));
+        }());
+        return pool;
     }
 
 
-    // Returns the name of the step
-    std::string getStepName() override {
-        return "Text Step";
+    // Opens a file for reading once a descriptor is free, returns -1 like open if it fails
+    int open(const std::string& name) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            returned.wait(lock, [this] { return available > 0; });
+            available--;
+        }
+        int fd = ::open(name.c_str(), O_RDONLY);
+        if (fd < 0) {
+            release();
+        }
+        return fd;
     }
 
 
-    // Displays the title and copy on the screen
-    void displayInfoOnScreen() override {
-        std::cout << "Text Step -> Title: " << title << ", Copy: " << copy << "\n";
+    // Closes a file opened through the pool
+    void close(int fd) {
+        ::close(fd);
+        release();
     }
 
-
-    // Called inside the output step
-    void addInfoToFile(std::string name) override {
-        std::ofstream file(name, std::ios::app); // Open the file in append mode
-        if (!file.is_open()) {
-            file << "Error opening file: " << name << "\n";
-            return;
+private:
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            available++;
         }
-        
-        file << "---------------------------\n";
-        file << "Text Step:\n";
-        file << "Text Title: " << title << "\n";
-        file << "Text Copy: " << copy << "\n";
-        file.close();
+        returned.notify_one();
     }
+};
 
 
-    // Main function that gets called when the step is executed
-    void execute() override {
-        std::string choice;
-        
-        // The user can't continue unless he either completes the step
-        // Or skips it
-        while (true) {
-            // Display available options
-            std::cout << "---------------------------\n";
-            std::cout << "Executing Text Step:\n";
-            std::cout << "1. Run this step\n";
-            std::cout << "2. Skip this step\n";
+// Tells two versions of a file apart: the same path can point to another file, or the file can change
+struct FileIdentity {
+    dev_t device = 0;
+    ino_t inode = 0;
+    off_t size = 0;
+    int64_t modified = 0; // Nanoseconds since the epoch
 
-            std::cout << "Enter your choice: ";
-            getline(std::cin, choice);
+    FileIdentity() {}
+    FileIdentity(const struct stat& info) : device(info.st_dev), inode(info.st_ino), size(info.st_size),
+        modified(int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec) {}
 
-            if (choice == "1") { // Run the step
-                // Ask the user to input the title and copy (just some text)
-                std::cout << "---------------------------\n";
-                std::cout << "Running Text Step:\n";
-                std::cout << "Text Title: " << title << "\n";
-                std::cout << "Text Copy: " << copy << "\n";
 
-                break; // Exit and continue with the next step
-            } else if (choice == "2") { // Skip the step
-                std::cout << "Skipping this Text Step...\n";
-                addSkip();
-                break; // Exit and continue with the next step
-            } else { // Invalid choice
-                std::cout << "Invalid choice! Please try again.\n";
-                addErrorAtIndex(0); // Error on the first screen
-            }
-        }
+    bool operator==(const FileIdentity& other) const {
+        return device == other.device && inode == other.inode && size == other.size && modified == other.modified;
     }
 };
 
 
-// TextInput class
-// Description is inputted when the object is created, text is inputted when the step is executed
-class TextInput : public Step {
+// Read-only memory mapping of a whole file
+class MappedFile {
 private:
-    std::string description;
-    std::string text = "NOTEXT";
+    const char* data = nullptr;
+    size_t size = 0;
+    FileIdentity identity; // The file that was mapped, as it was when it was mapped
 
 public:
-    TextInput(std::string description, std::string text) : description(description), text(text) {}
-    TextInput(std::string description) : description(description), text("NOTEXT") {}
-    TextInput() {
-        std::cout << "---------------------------\n";
-        std::cout << "Creating text input step:\n";
+    MappedFile(std::string name) {
+        DescriptorPool& pool = DescriptorPool::shared();
+        int fd = pool.open(name);
+        if (fd < 0) {
+            throw std::runtime_error("Error opening file: " + name);
+        }
 
-        // Get the description
-        std::cout << "Text Input Description: ";
-        std::string description;
-        getline(std::cin, description);
+        struct stat info;
+        if (fstat(fd, &info) < 0) {
+            pool.close(fd);
+            throw std::runtime_error("Error reading file: " + name);
+        }
 
-        // Assign the input to it's respective field
-        this->description = description;
+        size = info.st_size;
+        identity = FileIdentity(info);
+        if (size > 0) { // An empty file can't be mapped
+            void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                pool.close(fd);
+                throw std::runtime_error("Error mapping file: " + name);
+            }
+            data = static_cast<const char*>(mapping);
+        }
+
+        pool.close(fd); // The mapping stays valid after the descriptor is closed
     }
 
 
-    // Returns the name of the step
-    std::string getStepName() override {
-        return "Text Input Step";
+    ~MappedFile() {
+        if (data != nullptr) {
+            munmap(const_cast<char*>(data), size);
+        }
     }
 
 
-    // Returns the text description and text on the screen
-    void displayInfoOnScreen() override {
-        std::cout << "Text Input Step -> Description: " << description << ", Text: " << text << "\n";
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+
+    // Returns the start of the mapping
+    const char* getData() {
+        return data;
     }
 
 
-    // Called inside the output step
-    void addInfoToFile(std::string name) override {
-        std::ofstream file(name, std::ios::app); // Open the file in append mode
-        if (!file.is_open()) {
-            file << "Error opening file: " << name << "\n";
-            return;
-        }
-        
-        file << "---------------------------\n";
-        file << "Text Input Step:\n";
-        file << "Text Description: " << description << "\n";
-        file << "Text Input: " << text << "\n";
-        file.close();
+    // Returns the size of the file
+    size_t getSize() {
+        return size;
     }
 
 
-    // Main function that gets called when the step is executed
-    void execute() override {
-        this->text = "NOTEXT"; // Reset the text to the default value
+    // Returns which file was mapped and when it was last changed
+    const FileIdentity& getIdentity() {
+        return identity;
+    }
 
-        while (true) {
-            // Display available options
-            std::cout << "---------------------------\n";
-            std::cout << "Executing Text Input Step:\n";
-            std::cout << "1. Run this step\n";
-            std::cout << "2. Skip this step\n";
-            std::cout << "Enter your choice: ";
-            std::string choice;
-            getline(std::cin, choice);
 
-            if (choice == "1") { // Run the step
-                // Ask the user to input the description and text
-                std::cout << "---------------------------\n";
-                std::cout << "Running Text Input Step:\n";
-                std::cout << "Text Input Description: " << description << "\n";
-                std::cout << "Enter your Text: ";
-                std::string text;
-                getline(std::cin, text);
+    // Tells the kernel the given range will be read from start to end
+    void adviseSequential(size_t offset, size_t length) {
+        advise(offset, length, MADV_SEQUENTIAL);
+    }
 
-                // Asign the new input to it's respective field
-                this->text = text;
 
-                break; // Exit and continue with the next step
-            } else if (choice == "2") { // Skip the step
-                this->text = "NOTEXT"; // Reset the input, in case the step was executed before
-                std::cout << "Skipping this Text Input Step...\n";
-                addSkip();
-                break; // Exit and continue with the next step
-            } else { // Invalid choice
-                std::cout << "Invalid choice! Please try again.\n";
-                addErrorAtIndex(0); // Error on the first screen
-            }
+    // Drops the pages of the given range from memory, they are read again from the file if needed
+    void release(size_t offset, size_t length) {
+        advise(offset, length, MADV_DONTNEED);
+    }
+
+private:
+    // Applies an madvise hint to the whole pages inside a range
+    void advise(size_t offset, size_t length, int hint) {
+        static const size_t pageSize = sysconf(_SC_PAGESIZE);
+        if (data == nullptr || offset >= size) {
+            return;
+        }
+        size_t start = offset / pageSize * pageSize;
+        size_t end = std::min(size, offset + length);
+        if (end > start) {
+            madvise(const_cast<char*>(data) + start, end - start, hint);
         }
     }
 };
 
 
-template <typename T>
-// NumberInput class
-class NumberInput : public Step {
-private:
-    std::string description;
-    T number;
-
-public:
-    NumberInput(std::string description, float number) : description(description), number(number) {}
-    NumberInput(std::string description) : description(description), number(0) {}
-    NumberInput() {
-        std::cout << "---------------------------\n";
-        std::cout << "Creating Number Input Step:\n";
+// How well the file cache did so far
+struct FileCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t cachedFiles = 0;
+    uint64_t cachedBytes = 0;
+};
 
-        // Get the description
-        std::cout << "Number Description: ";
-        std::string description;
-        getline(std::cin, description);
 
-        // Assign the input to it's respective field
-        this->description = description;
+// Mappings of the files the steps read, shared by every step and every run of the process
+// A file is found by its path and only reused while it is still the same file with the same size and
+// modification time, so a file that was edited or replaced is mapped again. Mappings stay cached after
+// their last user is done with them, up to a memory budget, and the least recently used ones go first
+class FileCache {
+private:
+    struct Entry {
+        std::shared_ptr<MappedFile> file;
+        std::list<std::string>::iterator recent; // Position in the recently used list
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    std::list<std::string> recentlyUsed; // Paths of the entries, the most recently used first
+    size_t budget; // Bytes of mappings the cache can keep
+    FileCacheStats stats;
+
+    // Drops an entry, the mapping stays valid for whoever still holds it
+    void erase(std::unordered_map<std::string, Entry>::iterator entry) {
+        stats.cachedBytes -= entry->second.file->getSize();
+        stats.cachedFiles--;
+        recentlyUsed.erase(entry->second.recent);
+        entries.erase(entry);
     }
 
 
-    // Returns the name of the step
-    std::string getStepName() override {
-        return "Number Input Step";
+    // Drops the least recently used entries until the cache fits its budget
+    // Mappings still in use are kept, dropping them wouldn't free anything
+    void evict() {
+        auto position = recentlyUsed.end();
+        while (stats.cachedBytes > budget && position != recentlyUsed.begin()) {
+            --position;
+            auto entry = entries.find(*position);
+            if (entry->second.file.use_count() > 1) {
+                continue;
+            }
+            position = std::next(position);
+            erase(entry);
+            stats.evictions++;
+        }
     }
 
+public:
+    FileCache(size_t budget = size_t(1) << 30) : budget(budget) {}
 
-    // Returns the number
-    T getNumber() {
-        return number;
+
+    // Returns the cache every step uses
+    static FileCache& shared() {
+        static FileCache cache;
+        return cache;
     }
 
 
-    // Returns the description
-    std::string getDescription() {
-        return description;
-    }
+    // Returns the mapping of a file, mapping it if it isn't cached or changed since it was
+    // Throws like MappedFile if the file can't be opened
+    std::shared_ptr<MappedFile> acquire(const std::string& path) {
+        struct stat info;
+        if (stat(path.c_str(), &info) < 0) {
+            throw std::runtime_error("Error opening file: " + path);
+        }
 
+        std::lock_guard<std::mutex> lock(mutex);
+        auto entry = entries.find(path);
+        if (entry != entries.end()) {
+            if (entry->second.file->getIdentity() == FileIdentity(info)) {
+                stats.hits++;
+                recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, entry->second.recent);
+                return entry->second.file;
+            }
+            erase(entry); // An older version of the file
+        }
 
-    // Displays the description and number on the screen
-    void displayInfoOnScreen() override {
-        std::cout << "Number Input Step -> Description: " << description << ", Number: " << number << "\n";
+        stats.misses++;
+        std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(path);
+        recentlyUsed.push_front(path);
+        entries.emplace(path, Entry{file, recentlyUsed.begin()});
+        stats.cachedBytes += file->getSize();
+        stats.cachedFiles++;
+        evict();
+        return file;
     }
 
 
-    // Called inside the output step
-    void addInfoToFile(std::string name) override {
-        std::ofstream file(name, std::ios::app); // Open the file in append mode
-        if (!file.is_open()) {
-            file << "Error opening file: " << name << "\n";
-            return;
-        }
-        
-        file << "---------------------------\n";
-        file << "NumberInput Step:\n";
-        file << "Description: " << description << "\n";
-        file << "Number: " << number << "\n";
-        file.close();
+    // Returns the counters of the cache
+    FileCacheStats getStats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
     }
+};
 
 
-    // Main function that gets called when the step is executed
-    void execute() override {
-        this->number = 0; // Reset the number to the default value
-
-        std::string choice;
+// Returns a timestamp in nanoseconds for measuring durations
+inline uint64_t monotonicNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
-        // The user can't continue unless he either completes the step
-        // Or skips it
-        while (true) {
-            // Display available options
-            std::cout << "---------------------------\n";
-            std::cout << "Executing Number Input Step:\n";
-            std::cout << "1. Run this step\n";
-            std::cout << "2. Skip this step\n";
-            std::cout << "Enter your choice: ";
-            getline(std::cin, choice);
-            
-            if (choice == "1") { // Run the step
-                // Ask the user to input the description and number
-                std::cout << "---------------------------\n";
-                std::cout << "Running Number Input Step:\n";
-                std::cout << "Number Description: " << description << "\n";
 
-                bool validNumber = false;
+// Counters of the background writer
+struct WriteBehindStats {
+    uint64_t blocks = 0; // Blocks handed over to be written
+    uint64_t bytes = 0; // Bytes written
+    uint64_t batches = 0; // writev calls
+    uint64_t stalls = 0; // Times a writer waited for room in the queue
+    uint64_t stallNanos = 0; // Time spent waiting for room
+    uint64_t peakQueuedBytes = 0; // Most buffered bytes waiting at once
+    uint64_t compressedInput = 0; // Bytes that were compressed before being written
+};
 
-                while (!validNumber) { // Keep asking for a number until the user enters a valid one
-                    std::cout << "Enter your Number: ";
-                    std::string number;
-                    getline(std::cin, number); // Get the number as a string
 
-                    try {
-                        this->number = stof(number); // Convert the string to a float
-                        validNumber = true;
-                    } catch (const std::exception& e) {
-                        std::cout << "Invalid number! Please try again.\n";
-                        addErrorAtIndex(1); // Error on the second screen
-                    }
-                }
+// How reports are written, set once from the command line
+struct ReportFormat {
+    int compression = 0; // gzip level from 1 to 9, 0 writes the reports as they are
+    uint64_t rotateBytes = 0; // A report continues in a new file once its current file has this many bytes on disk, 0 never rotates
 
-                break;
-            } else if (choice == "2") { // Skip the step
-                this->number = 0; // Reset the input, in case the step was executed before
-                std::cout << "Skipping this Number Input Step...\n";
-                addSkip();
-                break; // Exit and continue with the next step
-            } else { // Invalid choice
-                std::cout << "Invalid choice! Please try again.\n";
-                addErrorAtIndex(0); // Error on the first screen
-            }
-        }
+    // Returns the format every output step uses
+    static ReportFormat& current() {
+        static ReportFormat format;
+        return format;
     }
 };
 
 
-// Stores all NumberInputStep objects of the current flow
-std::vector<NumberInput<float>*> currentFlowNumberInputs;
-
-
-// CalculusStep class
-class CalculusStep : public Step {
+// The files of one report, shared by its writer and the blocks queued for it
+// Only one ReportFile of a name is open at a time, a second one waits until the first is closed, so reports
+// of the same title written by several steps or runs never interleave and the size of the file on disk only
+// changes through the open one. A rotated report continues in its next part once the part on disk is full,
+// parts that exist already are appended to and never truncated
+class ReportFile {
 private:
-    float number1, number2, result;
-    std::string operation;
+    std::string name; // Name of the first part, without the .gz of a compressed report
+    ReportFormat format;
+    int fd = -1;
+    int part = 1; // Number of the part being written, counting from 1
+    uint64_t partSize = 0; // Bytes of the part on disk, as of the last fstat
+    bool locked = false; // True while the name is in the open names
+
+    // Names of the reports that are open
+    struct OpenNames {
+        std::mutex mutex;
+        std::condition_variable closed; // Signalled when a report was closed
+        std::unordered_set<std::string> names;
+
+        static OpenNames& shared() {
+            static OpenNames open;
+            return open;
+        }
+    };
 
 
-    // Checks if a string is a valid number
-    bool isValidNumber(const std::string& str) {
-        // Regular expression for a number
-        std::regex pattern("^[-+]?[0-9]*\\.?[0-9]+$");
+    // Opens the current part, or the first one after it that isn't full yet
+    bool openPart() {
+        while (true) {
+            fd = ::open(partName(part).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+            struct stat info;
+            if (fd < 0 || fstat(fd, &info) < 0) {
+                if (fd >= 0) {
+                    ::close(fd);
+                    fd = -1;
+                }
+                return false;
+            }
+            partSize = info.st_size;
+            if (format.rotateBytes == 0 || partSize < format.rotateBytes) {
+                return true;
+            }
+            ::close(fd);
+            fd = -1;
+            part++;
+        }
+    }
 
-        return std::regex_match(str, pattern);
+public:
+    // Waits until no other report of the same name is open, then opens it
+    ReportFile(std::string name, ReportFormat format) : name(name), format(format) {
+        OpenNames& open = OpenNames::shared();
+        std::unique_lock<std::mutex> lock(open.mutex);
+        open.closed.wait(lock, [&open, &name]() { return open.names.count(name) == 0; });
+        open.names.insert(name);
+        locked = true;
+        lock.unlock();
+
+        if (!openPart()) {
+            close();
+        }
     }
 
 
-    // Performs the Addition operation
-    void add() {
-        operation = "Addition";
-        result = number1 + number2;
+    ~ReportFile() {
+        close();
     }
 
 
-    // Performs the Subtraction operation
-    void subtract() {
-        operation = "Subtraction";
-        result = number1 - number2;
-    }
+    ReportFile(const ReportFile&) = delete;
+    ReportFile& operator=(const ReportFile&) = delete;
 
 
-    // Performs the Multiplication operation
-    void multiply() {
-        operation = "Multiplication";
-        result = number1 * number2;
+    // Returns the descriptor of the part being written, -1 if the report couldn't be opened
+    int getFd() {
+        return fd;
     }
 
 
-    // Performs the Division operation
-    void divide() {
-        operation = "Division";
-        try {
-            if (number2 == 0) {
-                throw std::runtime_error("Division by zero is not allowed.");
+    // Returns the name of a part of the report, the second part of report.txt is report.2.txt
+    std::string partName(int number) {
+        std::string file = name;
+        if (number > 1) {
+            size_t dot = file.rfind('.');
+            if (dot == std::string::npos || file.find('/', dot) != std::string::npos) {
+                dot = file.size();
             }
-            result = number1 / number2;
-        } catch (const std::exception& e) {
-            std::cout << "Error: " << e.what() << std::endl;
-            addErrorAtIndex(2); // Error on the third screen
+            file.insert(dot, "." + std::to_string(number));
         }
+        return format.compression > 0 ? file + ".gz" : file;
     }
 
 
-    // Performs the Min operation
-    void min() {
-        operation = "Min";
-        result = number1 < number2 ? number1 : number2;
+    // Returns how many more bytes fit into the part being written
+    uint64_t room() {
+        if (format.rotateBytes == 0) {
+            return UINT64_MAX;
+        }
+        return partSize < format.rotateBytes ? format.rotateBytes - partSize : 0;
     }
 
 
-    // Performs the Max operation
-    void max() {
-        operation = "Max";
-        result = number1 > number2 ? number1 : number2;
+    // Called after bytes were written, moves on to the next part if the current one is full on disk
+    // Returns false if the next part can't be opened
+    bool written() {
+        if (format.rotateBytes == 0 || fd < 0) {
+            return fd >= 0;
+        }
+        struct stat info;
+        if (fstat(fd, &info) < 0) {
+            return false;
+        }
+        partSize = info.st_size;
+        if (partSize < format.rotateBytes) {
+            return true;
+        }
+        ::close(fd);
+        fd = -1;
+        part++;
+        return openPart();
     }
 
-public:
-    CalculusStep() : number1(0), number2(0), result(0) {} // Default constructor
-
 
-    // Returns the name of the step
-    std::string getStepName() override {
-        return "Calculus Step";
+    // Closes the part being written and lets the next report of the same name open
+    void close() {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+        if (locked) {
+            OpenNames& open = OpenNames::shared();
+            {
+                std::lock_guard<std::mutex> lock(open.mutex);
+                open.names.erase(name);
+                locked = false;
+            }
+            open.closed.notify_all();
+        }
     }
+};
 
 
-    // Returns the result of the operation
-    float getResult() {
-        return result;
-    }
-
+// Writes the output files on a background thread, so a slow disk doesn't hold up the runs
+// Writers hand over full buffers, or mapped files, and go on. The thread takes everything queued at once
+// and writes the blocks of the same file together with one writev. The buffered bytes waiting are bounded,
+// a writer that would go over the limit waits until the thread caught up. Every block gets a ticket and
+// blocks are written in ticket order, so waiting for a ticket waits for everything handed over before it
+class WriteBehind {
+public:
+    static const size_t blockSize = 1 << 20; // Buffers of this size are reused once they were written
+
+    // Something to write at the end of a file
+    struct Block {
+        std::shared_ptr<ReportFile> file;
+        std::unique_ptr<char[]> buffer; // Owned bytes, or null if the block points into a mapping
+        std::shared_ptr<MappedFile> mapping; // Kept alive until the block is written
+        const char* data = nullptr;
+        size_t size = 0;
+        size_t capacity = 0; // Size of the owned buffer
+        bool closeAfter = false; // The report is closed once the block is written
+        int compression = 0; // gzip level the block is compressed with before it is written, 0 for none
+        std::vector<char> compressed; // The compressed bytes, data points to them once the block was compressed
+        std::shared_ptr<std::atomic<bool>> failed; // Set if the file couldn't be written
+    };
 
-    // Displays the numbers and result on the screen
-    void displayInfoOnScreen() override {
-        std::cout << "Calculus Step -> Number 1: " << number1 << ", Number 2: " << number2 << ", Operation: " << operation << ", Result: " << result << "\n";
+private:
+    static const size_t maxBatch = 1024; // Most blocks in one writev (IOV_MAX on Linux)
+
+    std::mutex mutex;
+    std::condition_variable queued; // Signalled when there is something to write or the writer stops
+    std::condition_variable room; // Signalled when blocks were written
+    std::vector<Block> queue;
+    size_t queuedBytes = 0; // Owned bytes queued or being written
+    size_t queueLimit;
+    uint64_t submitted = 0; // Ticket of the last block handed over
+    uint64_t written = 0; // Ticket of the last block written
+    std::vector<std::unique_ptr<char[]>> spare; // Written buffers of blockSize, handed out again
+    bool stopping = false;
+    WriteBehindStats stats;
+    std::thread thread;
+
+    // Threads helping the writer thread compress a batch, started the first time a batch has blocks to compress
+    std::mutex compressMutex;
+    std::condition_variable compressStart; // Signalled when a batch is ready to be compressed or the helpers stop
+    std::condition_variable compressDone; // Signalled when the last helper finished its part of the batch
+    std::vector<std::thread> compressors;
+    std::vector<Block*> compressing; // The blocks of the batch being compressed, only changed between batches
+    std::atomic<size_t> nextBlock{0}; // Index of the next block of compressing to be taken
+    size_t busyCompressors = 0;
+    uint64_t compressRound = 0; // Counts the batches handed to the helpers
+    bool stopCompressors = false;
+
+    // Compresses a block into a gzip member of its own, concatenated members are still one valid gzip file
+    static bool compressBlock(Block& block) {
+#ifdef FLOW_HAVE_ZLIB
+        z_stream stream = {};
+        if (deflateInit2(&stream, block.compression, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return false;
+        }
+        block.compressed.resize(deflateBound(&stream, block.size));
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(block.data));
+        stream.avail_in = block.size;
+        stream.next_out = reinterpret_cast<Bytef*>(block.compressed.data());
+        stream.avail_out = block.compressed.size();
+        bool done = deflate(&stream, Z_FINISH) == Z_STREAM_END;
+        block.compressed.resize(stream.total_out);
+        deflateEnd(&stream);
+        block.data = block.compressed.data();
+        block.size = block.compressed.size();
+        return done;
+#else
+        return false;
+#endif
     }
 
 
-    // Called inside the output step
-    void addInfoToFile(std::string name) override {
-        std::ofstream file(name, std::ios::app); // Open the file in append mode
-        if (!file.is_open()) {
-            file << "Error opening file: " << name << "\n";
-            return;
+    // Compresses blocks of the current batch until none is left
+    void compressBlocks() {
+        for (size_t i = nextBlock.fetch_add(1); i < compressing.size(); i = nextBlock.fetch_add(1)) {
+            if (!compressBlock(*compressing[i])) {
+                compressing[i]->failed->store(true, std::memory_order_relaxed);
+            }
         }
-        
-        file << "---------------------------\n";
-        file << "Calculus Step:\n";
-        file << "Number 1: " << number1 << "\n";
-        file << "Number 2: " << number2 << "\n";
-        file << "Operation: " << operation << "\n";
-        file << "Result: " << result << "\n";
-        file.close();
     }
 
 
-    // Main function that gets called when the step is executed
-    void execute() override {
+    // Body of the compression helpers, they sleep between batches
+    void runCompressor() {
+        uint64_t round = 0;
+        std::unique_lock<std::mutex> lock(compressMutex);
         while (true) {
-            // Display available options
-            std::cout << "---------------------------\n";
-            std::cout << "Executing Calculus Step:\n";
-            std::cout << "1. Run this step\n";
-            std::cout << "2. Skip this step\n";
-            std::cout << "Enter your choice: ";
-            std::string choice;
-            getline(std::cin, choice);
-
-            // If the user ran the step, he can't skip it unless he finishes it
-            if (choice == "1") { // Run the step
-                int chosenNumberInputIndex1 = -1; // The index of the first NumberInputStep object
-
-                if (currentFlowNumberInputs.size() == 0) { // If there are no NumberInputStep objects, the step can't be executed
-                    std::cout << "There are no Number Input Steps! Please create one first.\n";
-                    addErrorAtIndex(0); // Error on the first screen
-                    return;
-                }
-                
-                // Keep asking to choose a NumberInputStep until the user enters a valid one
-                while (chosenNumberInputIndex1 < 0 || chosenNumberInputIndex1 >= currentFlowNumberInputs.size()) {
-                    std::cout << "---------------------------\n";
-                    std::cout << "Running Calculus Step:\n";
-                    std::cout << "Choose the first number input step:\n";
-
-                    // Display a list of available NumberInputStep objects and let the user choose
-                    for (int i = 0; i < currentFlowNumberInputs.size(); i++) {
-                        std::cout << i + 1 << ". " << currentFlowNumberInputs[i]->getNumber() << " (" << currentFlowNumberInputs[i]->getDescription() << ")" << "\n";
-                    }
+            compressStart.wait(lock, [this, round]() { return compressRound != round || stopCompressors; });
+            if (stopCompressors) {
+                return;
+            }
+            round = compressRound;
+            lock.unlock();
+            compressBlocks();
+            lock.lock();
+            if (--busyCompressors == 0) {
+                compressDone.notify_one();
+            }
+        }
+    }
 
-                    // Get the user's choice
-                    std::cout << "Enter your choice: ";
-                    std::string chosenNumberInput1Str;
-                    getline(std::cin, chosenNumberInput1Str);
 
-                    // Verify that the user entered a valid number and within acceptable range
-                    if (isValidNumber(chosenNumberInput1Str)) {
-                        chosenNumberInputIndex1 = std::stoi(chosenNumberInput1Str) - 1;
-                        if (chosenNumberInputIndex1 < 0 || chosenNumberInputIndex1 >= currentFlowNumberInputs.size()) {
-                            std::cout << "Invalid choice! Please try again.\n";
-                            addErrorAtIndex(1); // Error on the second screen
-                        }
-                    }
-                    else { // The user didn't enter a valid number
-                        std::cout << "Invalid choice! Please enter a number.\n";
-                        addErrorAtIndex(1); // Error on the second screen
-                    }
-                }
+    // Compresses the blocks of a batch that ask for it, spread over all cores, returns the bytes that were compressed
+    uint64_t compressBatch(std::vector<Block>& batch) {
+        std::vector<Block*> blocks;
+        uint64_t input = 0;
+        for (auto& block : batch) {
+            if (block.compression > 0 && block.size > 0) {
+                blocks.push_back(&block);
+                input += block.size;
+            }
+        }
+        if (blocks.empty()) {
+            return 0;
+        }
 
-                int chosenNumberInputIndex2 = -1; // The index of the second NumberInputStep object
-                while (chosenNumberInputIndex2 < 0 || chosenNumberInputIndex2 >= currentFlowNumberInputs.size()) {
-                    std::cout << "---------------------------\n";
-                    std::cout << "Running Calculus Step:\n";
-                    std::cout << "Choose the second number input step:\n";
+        std::unique_lock<std::mutex> lock(compressMutex);
+        if (compressors.empty()) {
+            for (unsigned i = 1; i < std::thread::hardware_concurrency(); i++) {
+                compressors.emplace_back(&WriteBehind::runCompressor, this);
+            }
+        }
+        compressing.swap(blocks);
+        nextBlock.store(0);
+        busyCompressors = compressors.size();
+        compressRound++;
+        lock.unlock();
+        compressStart.notify_all();
+
+        // The writer thread compresses too, then waits for the helpers to finish their last blocks
+        compressBlocks();
+        lock.lock();
+        compressDone.wait(lock, [this]() { return busyCompressors == 0; });
+        compressing.clear();
+        return input;
+    }
 
-                    // Display a list of available NumberInputStep objects and let the user choose
-                    for (int i = 0; i < currentFlowNumberInputs.size(); i++) {
-                        std::cout << i + 1 << ". " << currentFlowNumberInputs[i]->getNumber() << " (" << currentFlowNumberInputs[i]->getDescription() << ")" << "\n";
-                    }
 
-                    // Get the user's choice
-                    std::cout << "Enter your choice: ";
-                    std::string chosenNumberInput2Str;
-                    getline(std::cin, chosenNumberInput2Str);
+    // Writes the blocks [first, last) of a batch, they all go to the same part of a report, returns false if it can't be written
+    static bool writeBlocks(std::vector<Block>& batch, size_t first, size_t last) {
+        struct iovec vectors[maxBatch];
+        size_t count = 0;
+        for (size_t i = first; i < last; i++) {
+            if (batch[i].size > 0) {
+                vectors[count].iov_base = const_cast<char*>(batch[i].data);
+                vectors[count].iov_len = batch[i].size;
+                count++;
+            }
+        }
 
-                    // Verify that the user entered a valid number and within acceptable range
-                    if (isValidNumber(chosenNumberInput2Str)) {
-                        chosenNumberInputIndex2 = std::stoi(chosenNumberInput2Str) - 1;
-                        if (chosenNumberInputIndex2 < 0 || chosenNumberInputIndex2 >= currentFlowNumberInputs.size()) {
-                            std::cout << "Invalid choice! Please try again.\n";
-                            addErrorAtIndex(1); // Error on the second screen
-                        }
-                    }
-                    else { // The user didn't enter a valid number
-                        std::cout << "Invalid choice! Please enter a number.\n";
-                        addErrorAtIndex(1); // Error on the second screen
-                    }
+        struct iovec* next = vectors;
+        while (count > 0) {
+            ssize_t done = writev(batch[first].file->getFd(), next, count);
+            if (done < 0) {
+                if (errno == EINTR) {
+                    continue;
                 }
+                return false;
+            }
 
-                // Get the numbers from the chosen NumberInputStep objects
-                number1 = currentFlowNumberInputs[chosenNumberInputIndex1]->getNumber();
-                number2 = currentFlowNumberInputs[chosenNumberInputIndex2]->getNumber();
-
-                // Ask the user to choose an operation, can't be skipped
-                while (true) {
-                    // Display available options
-                    std::cout << "---------------------------\n";
-                    std::cout << "Running Calculus Step:\n";
-                    std::cout << "Choose the operation:\n";
-                    std::cout << "1. Addition\n";
-                    std::cout << "2. Subtraction\n";
-                    std::cout << "3. Multiplication\n";
-                    std::cout << "4. Division\n";
-                    std::cout << "5. Min\n";
-                    std::cout << "6. Max\n";
+            // Skip what was written, a partial write can end in the middle of a block
+            while (count > 0 && size_t(done) >= next->iov_len) {
+                done -= next->iov_len;
+                next++;
+                count--;
+            }
+            if (count > 0) {
+                next->iov_base = static_cast<char*>(next->iov_base) + done;
+                next->iov_len -= done;
+            }
+        }
+        return true;
+    }
 
-                    // Get the user's choice
-                    // Can be the number coresponding to each operation or the operation symbol
-                    std::cout << "Enter your choice: ";
-                    std::string operationChoice;
-                    getline(std::cin, operationChoice);
 
-                    // Perform the calculation based on the user's choices
-                    if (operationChoice == "1" || operationChoice == "+") { // Addition
-                        add();
-                        std::cout << "Result of " << number1 << " + " << number2 << " = " << result << "\n";
-                        return; // Exit and continue with the next step
-                    } else if (operationChoice == "2" || operationChoice == "-") { // Subtraction
-                        subtract();
-                        std::cout << "Result of " << number1 << " - " << number2 << " = " << result << "\n";
-                        return; // Exit and continue with the next step
-                    } else if (operationChoice == "3" || operationChoice == "*") { // Multiplication
-                        multiply();
-                        std::cout << "Result of " << number1 << " * " << number2 << " = " << result << "\n";
-                        return; // Exit and continue with the next step
-                    } else if (operationChoice == "4" || operationChoice == "/") { // Division
-                        divide();
-                        std::cout << "Result of " << number1 << " / " << number2 << " = " << result << "\n";
-                        return; // Exit and continue with the next step
-                    } else if (operationChoice == "5") { // Min
-                        min();
-                        std::cout << "Result of min(" << number1 << ", " << number2 << ") = " << result << "\n";
-                        return; // Exit and continue with the next step
-                    } else if (operationChoice == "6") { // Max
-                        max();
-                        std::cout << "Result of max(" << number1 << ", " << number2 << ") = " << result << "\n";
-                        return; // Exit and continue with the next step
+    // Body of the writer thread
+    void run() {
+        std::vector<Block> batch;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            queued.wait(lock, [this]() { return !queue.empty() || stopping; });
+            if (queue.empty()) {
+                return;
+            }
+            batch.swap(queue);
+            uint64_t last = submitted;
+            lock.unlock();
+
+            uint64_t compressedInput = compressBatch(batch);
+
+            // Runs of blocks for the same report are written together, a run ends where its report is closed
+            // or where the part being written gets full, blocks are compressed by now so full means full on disk
+            uint64_t batches = 0;
+            uint64_t bytes = 0;
+            for (size_t first = 0; first < batch.size();) {
+                ReportFile& file = *batch[first].file;
+                uint64_t room = file.room();
+                uint64_t runBytes = batch[first].size;
+                size_t end = first + 1;
+                while (end < batch.size() && end - first < maxBatch && batch[end].file == batch[first].file && !batch[end - 1].closeAfter
+                       && runBytes < room) {
+                    runBytes += batch[end].size;
+                    end++;
+                }
+                std::atomic<bool>& failed = *batch[first].failed;
+                if (!failed.load(std::memory_order_relaxed)) {
+                    if (file.getFd() >= 0 && writeBlocks(batch, first, end) && file.written()) {
+                        bytes += runBytes;
                     } else {
-                        std::cout << "Invalid operation choice!\n";
-                        addErrorAtIndex(2); // Error on the third screen
+                        failed.store(true, std::memory_order_relaxed);
                     }
+                    batches++;
                 }
-            } else if (choice == "2") { // Skip the step
-                std::cout << "Skipping this Calculus Step...\n";
-                addSkip();
-                return;
-            } else { // Invalid choice
-                std::cout << "Invalid choice! Please try again.\n";
-                addErrorAtIndex(0); // Error on the first screen
+                if (batch[end - 1].closeAfter) {
+                    file.close();
+                }
+                first = end;
             }
+
+            lock.lock();
+            for (auto& block : batch) {
+                queuedBytes -= block.capacity;
+                if (block.capacity == blockSize && spare.size() < queueLimit / blockSize) {
+                    spare.push_back(std::move(block.buffer));
+                }
+            }
+            batch.clear();
+            stats.batches += batches;
+            stats.bytes += bytes;
+            stats.compressedInput += compressedInput;
+            written = last;
+            room.notify_all();
         }
     }
-};
 
+public:
+    WriteBehind(size_t queueLimit = 64 << 20) : queueLimit(queueLimit) {
+        thread = std::thread(&WriteBehind::run, this);
+    }
 
-// Stores all CalculusStep objects of the current flow
-std::vector<CalculusStep*> currentFlowCalculusSteps;
 
+    WriteBehind(const WriteBehind&) = delete;
+    WriteBehind& operator=(const WriteBehind&) = delete;
 
-// TextFileStep class
-class TextFileStep : public Step {
-private:
-    std::string description;
-    std::string name = "NOFILE"; // Default value
-    std::ifstream file;
 
-public:
-    TextFileStep() {
-        std::cout << "---------------------------\n";
-        std::cout << "Creating Text File Step:\n";
+    // Everything handed over is written before the thread stops
+    ~WriteBehind() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        queued.notify_one();
+        thread.join();
 
-        // Get the description
-        std::cout << "Text File Description: ";
-        std::string description;
-        getline(std::cin, description);
+        {
+            std::lock_guard<std::mutex> lock(compressMutex);
+            stopCompressors = true;
+        }
+        compressStart.notify_all();
+        for (auto& compressor : compressors) {
+            compressor.join();
+        }
+    }
 
-        // Assign the input to it's respective field
-        this->description = description;
+
+    // Returns the writer the output steps use
+    static WriteBehind& shared() {
+        static WriteBehind writer;
+        return writer;
     }
 
 
-    TextFileStep(std::string description, std::string name) : description(description), name(name + ".txt") {
-        try {
-            file.open(this->name);
-            if (!file) {
-                throw std::runtime_error("File not found!");
+    // Returns an empty buffer of the given size, a written one if there is one
+    std::unique_ptr<char[]> takeBuffer(size_t size) {
+        if (size == blockSize) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!spare.empty()) {
+                std::unique_ptr<char[]> buffer = std::move(spare.back());
+                spare.pop_back();
+                return buffer;
             }
-        } catch (const std::exception& e) { // Throw an error if the file does not exist
-            std::cout << "Error: " << e.what() << std::endl;
         }
+        return std::unique_ptr<char[]>(new char[size]);
     }
 
 
-    // Returns the name of the step
-    std::string getStepName() override {
-        return "File Input Step";
+    // Queues a block and returns its ticket, waits first if the queue holds too many buffered bytes
+    uint64_t submit(Block block) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (queuedBytes > 0 && queuedBytes + block.capacity > queueLimit) {
+            uint64_t start = monotonicNanos();
+            room.wait(lock, [this, &block]() { return queuedBytes == 0 || queuedBytes + block.capacity <= queueLimit; });
+            stats.stalls++;
+            stats.stallNanos += monotonicNanos() - start;
+        }
+
+        queuedBytes += block.capacity;
+        stats.peakQueuedBytes = std::max<uint64_t>(stats.peakQueuedBytes, queuedBytes);
+        stats.blocks++;
+        queue.push_back(std::move(block));
+        uint64_t ticket = ++submitted;
+        lock.unlock();
+        queued.notify_one();
+        return ticket;
     }
 
 
-    // Returns the name of the file
-    std::string getName() {
-        return name;
+    // Waits until the block with the given ticket and every block before it were written
+    void wait(uint64_t ticket) {
+        std::unique_lock<std::mutex> lock(mutex);
+        room.wait(lock, [this, ticket]() { return written >= ticket; });
     }
 
 
-    // Displays the name of the stored file
-    void displayInfoOnScreen() override {
-        std::cout << "TextFile Step -> Description: " << description << ", Name: " << name << "\n";
+    // Returns the counters of the writer
+    WriteBehindStats getStats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
     }
+};
 
 
-    // Called inside the output step, adds the info to the file
-    void addInfoToFile(std::string name) override {
-        std::ofstream file(name, std::ios::app); // Open the file in append mode
-        if (!file.is_open()) {
-            file << "Error opening file: " << name << "\n";
-            return;
-        }
-        
-        file << "---------------------------\n";
-        file << "TextFile Step:\n";
-        file << "Text File Description: " << this->description << "\n";
-        file << "File Name: " << this->name << "\n";
-        file << "Contents:\n";
-        file.close();
+// A report whose writes were handed to the background writer and may not be on disk yet
+struct PendingReport {
+    std::string name;
+    WriteBehind* writer;
+    uint64_t ticket; // Ticket of the last block of the report
+    std::shared_ptr<std::atomic<bool>> failed;
+};
 
-        addContentsFromFirstFileToSecond(this->name, name);
+
+// Appends the binary representation of flows and steps to a buffer
+class SnapshotWriter {
+private:
+    std::string buffer;
+
+public:
+    void writeU8(uint8_t value) {
+        buffer.push_back(static_cast<char>(value));
     }
 
 
-    // Main function that gets called when the step is executed
-    void execute() override {
-        std::string choice = "0";
+    void writeU32(uint32_t value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
 
-        while (choice != "1" || choice != "2") {
-            // Display available options
-            std::cout << "---------------------------\n";
-            std::cout << "Executing Text File Step:\n";
-            std::cout << "1. Run this step\n";
-            std::cout << "2. Skip this step\n";
 
-            // Get the user's choice
-            std::cout << "Enter your choice: ";
-            getline(std::cin, choice);
+    void writeU64(uint64_t value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
 
-            std::string filename;
 
-            if (choice == "1") { // Run the step
-                while (true) {
-                    std::cout << "---------------------------\n";
-                    std::cout << "Running Text File Step:\n";
-                    std::cout << "File description: " << description << "\n";
+    // Strings are stored as their length followed by their bytes
+    void writeString(const std::string& value) {
+        writeU32(value.size());
+        buffer.append(value);
+    }
 
-                    std::cout << "Enter File Name: ";
-                    std::string filename;
-                    getline(std::cin, filename);
 
-                    if (!fopen((filename + ".txt").c_str(), "r")) { // Check if the file exists
-                        std::cout << "File not found! It will not be added.\n";
-                        addErrorAtIndex(1); // Error on the second screen
-                        return;
-                    } else {
-                        this->name = filename + ".txt";
-                        break;
-                    }
-                }
+    // Copies an already serialized record as it is
+    void writeRaw(const char* data, size_t size) {
+        buffer.append(data, size);
+    }
 
-                return; // Exit and continue with the next step
-            } else if (choice == "2") { // Skip the step
-                this->name = "NOFILE"; // Reset the input, in case the step was executed before
-                std::cout << "Skipping this step...\n";
-                addSkip();
-                break; // Exit and continue with the next step
-            } else { // Invalid choice
-                std::cout << "Invalid choice! Please try again.\n";
-                addErrorAtIndex(0); // Error on the first screen
-            }
-        }
+
+    // Overwrites a value written earlier, used to patch the header
+    void patchU64(size_t offset, uint64_t value) {
+        memcpy(&buffer[offset], &value, sizeof(value));
     }
-};
 
 
-// Stores all TextFileStep objects of the current flow
-std::vector<TextFileStep*> currentFlowTextFileSteps;
+    size_t getSize() {
+        return buffer.size();
+    }
 
 
-// CsvFileStep class
-class CsvFileStep : public Step {
-private:
-    std::string description;
-    std::string name = "NOFILE"; // Default value
-    std::ifstream file;
+    // Empties the buffer but keeps its memory, so the writer can be reused
+    void clear() {
+        buffer.clear();
+    }
 
-public:
-    // Default constructor is called when creating the flow
-    CsvFileStep() {
-        std::cout << "---------------------------\n";
-        std::cout << "Creating Csv File Step:\n";
 
-        // Get the description
-        std::cout << "Csv File Description: ";
-        std::string description;
-        getline(std::cin, description);
-
-        // Assign the input to it's respective field
-        this->description = description;
+    std::string& getBuffer() {
+        return buffer;
     }
+};
 
 
-    CsvFileStep(std::string description, std::string name) : description(description), name(name + ".csv") {
-        try {
-            file.open(this->name);
-            if (!file) {
-                throw std::runtime_error("File not found!");
-            }
-        } catch (const std::exception& e) {
-            std::cout << "Error: " << e.what() << std::endl;
+// Reads the values written by SnapshotWriter, every read is bounds checked
+class SnapshotReader {
+private:
+    const char* data;
+    size_t size;
+    size_t position = 0;
+    uint32_t version; // The snapshot version the data was written by
+
+    // Makes sure there are enough bytes left
+    void require(size_t count) {
+        if (count > size - position) {
+            throw std::runtime_error("The flow snapshot is corrupted");
         }
     }
 
+public:
+    SnapshotReader(const char* data, size_t size, uint32_t version) : data(data), size(size), version(version) {}
 
-    // Returns the name of the step
-    std::string getStepName() override {
-        return "Csv File Step";
+
+    uint32_t getVersion() {
+        return version;
     }
 
 
-    // Returns the name of the file
-    std::string getName() {
-        return name;
+    uint8_t readU8() {
+        require(1);
+        return static_cast<uint8_t>(data[position++]);
     }
 
 
-    // Displays the name of the stored file
-    void displayInfoOnScreen() override {
-        std::cout << "CsvFile Step -> Description: " << description << ", Name: " << name << "\n";
+    uint32_t readU32() {
+        uint32_t value;
+        require(sizeof(value));
+        memcpy(&value, data + position, sizeof(value));
+        position += sizeof(value);
+        return value;
     }
 
 
-    // Called inside the output step, adds the info to the file
-    void addInfoToFile(std::string name) override {
-        std::ofstream file(name, std::ios::app); // Open the file in append mode
+    uint64_t readU64() {
+        uint64_t value;
+        require(sizeof(value));
+        memcpy(&value, data + position, sizeof(value));
+        position += sizeof(value);
+        return value;
+    }
 
-        if (!file.is_open()) {
-            file << "Error opening file: " << name << "\n";
-            return;
-        }
-        
-        file << "---------------------------\n";
-        file << "CsvFile Step:\n";
-        file << "Description: " << description << "\n";
-        file << "Name: " << name << "\n";
-        file << "Contents:\n";
-        addContentsFromFirstFileToSecond(this->name, name); // Add the contents of the csv file to the output file
-        file.close();
+
+    std::string readString() {
+        uint32_t length = readU32();
+        require(length);
+        std::string value(data + position, length);
+        position += length;
+        return value;
     }
 
 
-    // Main function that gets called when the step is executed
-    void execute() override {
-        std::string choice = "0";
-        while (choice != "1" || choice != "2") {
-            // Display available options
-            std::cout << "---------------------------\n";
-            std::cout << "Running CsvFile Step:\n";
-            std::cout << "1. Run this step\n";
-            std::cout << "2. Skip this step\n";
+    // Returns true if everything was read
+    bool atEnd() {
+        return position == size;
+    }
 
-            // Get the user's choice
-            std::cout << "Enter your choice: ";
-            getline(std::cin, choice);
 
-            if (choice == "1") { // Run the step
-                while (true) {
-                    std::cout << "---------------------------\n";
-                    std::cout << "Running CsvFile Step:\n";
-                    std::cout << "File description: " << description << "\n";
+    // Moves past a string without copying it
+    void skipString() {
+        uint32_t length = readU32();
+        require(length);
+        position += length;
+    }
+};
 
-                    std::cout << "Enter File Name: ";
-                    std::string filename;
-                    getline(std::cin, filename);
 
-                    if (!fopen((filename + ".csv").c_str(), "r")) { // Check if the file exists
-                        std::cout << "File not found! It will not be added.\n";
-                        addErrorAtIndex(1); // Error on the second screen
-                        return;
-                    } else {
-                        this->name = filename + ".csv";
-                        break;
-                    }
-                }
+// Kinds of entries in a run record, the record of a run is the flow name, the definition hash of the flow
+// (since version 2), the wall clock time the run started at and then these events in the order they happened
+enum class JournalEvent : uint8_t {
+    Step = 1, // The next step starts: kind (u8)
+    Answer, // An answer was read: screen (u8), answer (string)
+    Error, // An answer was rejected: screen (u8)
+    Skip, // The step was skipped
+    Result, // What the step produced: result (string)
+    End // The run is over: duration in nanoseconds (u64), completed (u8)
+};
 
-                return; // Exit and continue with the next step
-            } else if (choice == "2") {
-                this->name = "NOFILE"; // Reset the input, in case the step was executed before
-                std::cout << "Skipping this step...\n";
-                addSkip();
-                break; // Exit and continue with the next step
-            } else { // Invalid choice
-                std::cout << "Invalid choice! Please try again.\n";
-                addErrorAtIndex(0); // Error on the first screen
+
+// Returns the FNV-1a hash of some bytes, used to detect torn journal records
+// A hash can be continued by passing it back in
+uint32_t checksum(const char* data, size_t size, uint32_t hash = 2166136261u) {
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+
+// Frames the records of the append-only files, the run journal and the change log of the flows, so a reader
+// can tell a record torn by a crash at the end of the file from a damaged one in the middle:
+//   magic (u32), sequence number (u32), length (u32), checksum of the header (u32), checksum of the bytes (u32), bytes
+// The sequence numbers count the records of a file from 0. Both checksums start from a key that is random
+// for every file, so bytes written as part of a record, like the answers of a run, can't pass as a frame
+class FrameFormat {
+private:
+    uint32_t magic;
+    uint32_t key;
+
+
+    // Returns the checksum of the fields of a header
+    uint32_t headerChecksum(uint32_t sequence, uint32_t length) const {
+        uint32_t fields[2] = {sequence, length};
+        return checksum(reinterpret_cast<const char*>(fields), sizeof(fields), key);
+    }
+
+public:
+    static const size_t headerSize = 20;
+    static const size_t maxTornBytes = 128 << 20; // More than a single write of either file, a crash tears at most one
+
+
+    FrameFormat(uint32_t magic, uint32_t key) : magic(magic), key(key) {}
+
+
+    // Returns a key for a new file
+    static uint32_t newKey() {
+        std::random_device random;
+        return random();
+    }
+
+
+    uint32_t getKey() const {
+        return key;
+    }
+
+
+    // Appends a framed record
+    void append(std::string& out, uint32_t sequence, const char* data, size_t size) const {
+        uint32_t length = size;
+        uint32_t header[5] = {magic, sequence, length, headerChecksum(sequence, length), checksum(data, size, key)};
+        out.append(reinterpret_cast<const char*>(header), sizeof(header));
+        out.append(data, size);
+    }
+
+
+    // Returns the size of the intact frame with the given sequence number at a position, header included,
+    // or 0 if there is none
+    size_t frameAt(const char* data, size_t size, size_t position, uint32_t sequence) const {
+        if (position > size || size - position < headerSize) {
+            return 0;
+        }
+        uint32_t header[5];
+        memcpy(header, data + position, sizeof(header));
+        if (header[0] != magic || header[1] != sequence || header[3] != headerChecksum(header[1], header[2])
+            || header[2] > size - position - headerSize || checksum(data + position + headerSize, header[2], key) != header[4]) {
+            return 0;
+        }
+        return headerSize + header[2];
+    }
+
+
+    // Returns true if the damaged frame with the given sequence number at a position is in the middle of the file
+    // That is the case if intact frames numbered after it run from somewhere after it to the end of the file.
+    // Only the positions where the magic appears are tried, and their header checksum rules out most of them
+    // before any bytes are read. A damaged frame followed by more bytes than one write could have torn is
+    // in the middle anyway, so the scan never goes further than that
+    bool hasFramesAfter(const char* data, size_t size, size_t position, uint32_t sequence) const {
+        if (size - position > maxTornBytes) {
+            return true;
+        }
+        const char* end = data + size;
+        for (const char* found = data + position + 1; found < end; found++) {
+            found = static_cast<const char*>(memmem(found, end - found, &magic, sizeof(magic)));
+            if (found == nullptr || end - found < static_cast<ptrdiff_t>(headerSize)) {
+                return false;
+            }
+            uint32_t header[4];
+            memcpy(header, found, sizeof(header));
+            if (header[1] <= sequence || header[3] != headerChecksum(header[1], header[2])) {
+                continue;
+            }
+            size_t next = found - data;
+            uint32_t number = header[1];
+            while (size_t frame = frameAt(data, size, next, number)) {
+                next += frame;
+                number++;
+            }
+            if (next == size) {
+                return true;
             }
         }
+        return false;
     }
 };
 
 
-// Stores all CsvFileStep objects of the current flow
-std::vector<CsvFileStep*> currentFlowCsvFileSteps;
+// Returns the 64-bit FNV-1a hash of some bytes, a hash can be continued by passing it back in
+uint64_t hash64(const char* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * 1099511628211ull;
+    }
+    return hash;
+}
+
 
+// A run read back from the journal, with everything needed to replay it
+struct RecordedRun {
+    std::string flowName;
+    uint64_t definition = 0; // Definition hash of the flow that was run, 0 for records written before version 2
+    uint64_t startedAt = 0; // Wall clock time in nanoseconds
+    uint64_t duration = 0; // In nanoseconds
+    bool completed = false;
+    std::vector<std::string> answers; // Every answer the run read, in order
+};
 
-// DisplayStep class
-class DisplayStep : public Step {
+
+// Append-only file with one record for every run
+// Runs hand over their finished record and go on, a background thread collects the records of a whole
+// sync interval and writes and syncs them together, so many runs share one write and one fsync.
+// Every record is framed (see FrameFormat), a torn last record is detected when the journal is read
+// and cut off before the next records are appended
+class RunJournal {
 private:
-    std::string filename;
+    static constexpr char magic[8] = {'F', 'L', 'O', 'W', 'J', 'R', 'N', 'L'};
+    // Version 2 added the definition hash of the flow to every record, version 3 the frame key to the header and
+    // the frame magic and sequence numbers to every record. The records of older versions are framed by just
+    // their length and checksum
+    static const uint32_t version = 3;
+    static const uint32_t frameMagic = 0x4e55524a; // "JRUN" in the file
+    static const size_t batchSize = 1 << 20; // A batch this large is written without waiting for the sync interval
+    static const size_t maxPending = 64 << 20; // Runs wait once this many bytes are waiting to be written
+
+    int fd = -1;
+    uint32_t fileVersion = version; // The version of the journal being appended to, records are written in it
+    FrameFormat frames{frameMagic, FrameFormat::newKey()};
+    uint32_t nextSequence = 0; // Sequence number of the next record
+    std::chrono::milliseconds syncInterval; // Zero syncs after every write
+    std::mutex mutex;
+    std::condition_variable wake; // Signalled when there is something to write or the journal closes
+    std::condition_variable room; // Signalled when the writer took the pending records
+    std::string pending; // Framed records waiting to be written
+    uint64_t stalls = 0; // Times a run waited for room in pending
+    bool closing = false;
+    std::atomic<bool> failed{false}; // Set when a write failed, nothing is written after that
+    std::thread writer;
+
+
+    // Writes a batch of records, returns false if the file can't be written
+    bool writeAll(const std::string& batch) {
+        size_t done = 0;
+        while (done < batch.size()) {
+            ssize_t count = write(fd, batch.data() + done, batch.size() - done);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            done += count;
+        }
+        return true;
+    }
 
-    bool emptyFileAndCsvSteps() {
-        bool csv = false;
-        bool text = false;
 
-        for (auto file : currentFlowTextFileSteps) {
-            if (file->getName() != "NOFILE") {
-                text = true;
+    // Returns where the records of a journal of the given version start
+    static size_t headerSize(uint32_t fileVersion) {
+        return sizeof(magic) + (fileVersion >= 3 ? 8 : 4);
+    }
+
+
+    // Finds the sequence number the next record gets, a torn last record is cut off so the next ones follow
+    // the intact ones. Usually the last record ends the file and is found by looking back from the end
+    void findEnd(const std::string& path) {
+        MappedFile file(path);
+        const char* data = file.getData();
+        size_t size = file.getSize();
+        const size_t start = headerSize(fileVersion);
+        const size_t lookBack = 1 << 20;
+        for (size_t position = size - std::min(size, FrameFormat::headerSize); position >= start && size - position <= lookBack; position--) {
+            uint32_t header[2];
+            memcpy(header, data + position, sizeof(header));
+            if (header[0] == frameMagic && position + frames.frameAt(data, size, position, header[1]) == size) {
+                nextSequence = header[1] + 1;
+                return;
             }
         }
 
-        for (auto file : currentFlowCsvFileSteps) {
-            if (file->getName() != "NOFILE") {
-                csv = true;
+        // The last record is large or torn, the intact records are counted from the start
+        size_t end = start;
+        while (size_t frame = frames.frameAt(data, size, end, nextSequence)) {
+            end += frame;
+            nextSequence++;
+        }
+        if (end < size) {
+            if (frames.hasFramesAfter(data, size, end, nextSequence)) {
+                throw std::runtime_error(path + " is corrupted, record " + std::to_string(nextSequence + 1) + " at byte "
+                    + std::to_string(end) + " is damaged");
+            }
+            if (ftruncate(fd, end) != 0) {
+                throw std::runtime_error("Error writing file: " + path);
             }
         }
+    }
 
-        return csv || text;
+
+    // Body of the writer thread
+    void run() {
+        std::string batch;
+        auto lastSync = std::chrono::steady_clock::now();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            // Sleep until there is something to write, then give the runs until the sync is due to add
+            // more records to the same batch, unless the batch is full already
+            wake.wait(lock, [this]() { return !pending.empty() || closing; });
+            wake.wait_until(lock, lastSync + syncInterval, [this]() { return pending.size() >= batchSize || closing; });
+            batch.swap(pending);
+            bool last = closing;
+            lock.unlock();
+            room.notify_all();
+
+            if (!batch.empty() && !failed.load(std::memory_order_relaxed)) {
+                if (writeAll(batch)) {
+                    fdatasync(fd);
+                } else {
+                    failed.store(true, std::memory_order_relaxed);
+                }
+            }
+            batch.clear();
+            lastSync = std::chrono::steady_clock::now();
+
+            lock.lock();
+            if (last && pending.empty()) {
+                return;
+            }
+        }
     }
 
 public:
-    DisplayStep(std::string filename) : filename(filename) {}
-    DisplayStep() : filename("NOFILE") {} // Default constructor
+    // Opens the journal for appending, a new journal starts with its header
+    // The records added to an existing journal are written in the version of its header
+    RunJournal(const std::string& path, std::chrono::milliseconds syncInterval) : syncInterval(syncInterval) {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) < 0) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            throw std::runtime_error("Error opening file: " + path);
+        }
+        if (info.st_size > 0) {
+            char header[sizeof(magic) + 8];
+            ssize_t count = pread(fd, header, sizeof(header), 0);
+            if (count < static_cast<ssize_t>(sizeof(magic) + 4) || memcmp(header, magic, sizeof(magic)) != 0) {
+                ::close(fd);
+                throw std::runtime_error(path + " is not a run journal");
+            }
+            memcpy(&fileVersion, header + sizeof(magic), sizeof(fileVersion));
+            if (fileVersion < 1 || fileVersion > version || count < static_cast<ssize_t>(headerSize(fileVersion))) {
+                ::close(fd);
+                throw std::runtime_error(path + " was written by an unsupported version");
+            }
+            if (fileVersion >= 3) {
+                uint32_t key;
+                memcpy(&key, header + sizeof(magic) + 4, sizeof(key));
+                frames = FrameFormat(frameMagic, key);
+                try {
+                    findEnd(path);
+                } catch (...) {
+                    ::close(fd);
+                    throw;
+                }
+            }
+        } else {
+            SnapshotWriter header;
+            header.writeRaw(magic, sizeof(magic));
+            header.writeU32(version);
+            header.writeU32(frames.getKey());
+            if (!writeAll(header.getBuffer())) {
+                ::close(fd);
+                throw std::runtime_error("Error writing file: " + path);
+            }
+        }
+        writer = std::thread(&RunJournal::run, this);
+    }
 
 
-    // Returns the name of the step
-    std::string getStepName() override {
-        return "Display Step";
+    RunJournal(const RunJournal&) = delete;
+    RunJournal& operator=(const RunJournal&) = delete;
+
+
+    // Everything appended so far is written and synced before the file is closed
+    ~RunJournal() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closing = true;
+        }
+        wake.notify_one();
+        writer.join();
+        ::close(fd);
     }
 
 
-    // Displays the name of the stored file
-    void displayInfoOnScreen() override {
-        std::cout << "Display Step -> Filename: " << filename << "\n";
+    // Returns the version the records have to be written in
+    uint32_t getVersion() {
+        return fileVersion;
     }
 
 
-    // Didnt really need this, it just had to be defined
-    void addInfoToFile(std::string name) override {
-        return;
+    // Queues a run record, it becomes durable with the next sync
+    // Waits while the writer is too far behind, so a slow disk can't make the pending records grow without bound
+    void append(const std::string& record) {
+        bool wakeWriter;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (pending.size() >= maxPending) {
+                stalls++;
+                room.wait(lock, [this]() { return pending.size() < maxPending; });
+            }
+            size_t before = pending.size();
+            if (fileVersion >= 3) {
+                frames.append(pending, nextSequence++, record.data(), record.size());
+            } else {
+                uint32_t frame[2] = {static_cast<uint32_t>(record.size()), checksum(record.data(), record.size())};
+                pending.append(reinterpret_cast<const char*>(frame), sizeof(frame));
+                pending.append(record);
+            }
+            // The writer only has to be woken by the first record of a batch and when the batch gets full
+            wakeWriter = before == 0 || (before < batchSize && pending.size() >= batchSize);
+        }
+        if (wakeWriter) {
+            wake.notify_one();
+        }
     }
 
 
-    // Main function that gets called when the step is executed
-    void execute() override {
-        while (true) {
-            // Display available options
-            std::cout << "---------------------------\n";
-            std::cout << "Running Display Step:\n";
-            std::cout << "1. Run this step\n";
-            std::cout << "2. Skip this step\n";
+    // Returns true if writing the journal failed, the records after the failure were lost
+    bool hasFailed() {
+        return failed.load(std::memory_order_relaxed);
+    }
 
-            // Get the user's choice
-            std::cout << "Enter your choice: ";
-            std::string choice;
-            getline(std::cin, choice);
 
-            if (choice == "1") { // Run the step
+    // Returns how many times a run waited for the writer to catch up
+    uint64_t getStalls() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stalls;
+    }
 
-                // If there's no previous text or csv file, display stpe gets skipped forcefully
-                if (!emptyFileAndCsvSteps()) {
-                    std::cout << "Can't run Display Step, no file available to be displayed!\n";
-                    std::cout << "Skipping this Display Step...\n";
-                    return;
-                }
 
-                while (true) {
-                    // Display all available text and csv files
-                    std::cout << "---------------------------\n";
-                    std::cout << "Display the contents of which file:\n";
+    // Returns the size of the intact record of an older journal at a position, header included, 0 if there is none
+    // Those frames have no magic to look for, so a damaged one is taken as torn if no more than one write follows it
+    static size_t legacyFrameAt(const std::string& path, const char* data, size_t size, size_t position, size_t record) {
+        uint32_t header[2];
+        memcpy(header, data + position, sizeof(header));
+        if (header[0] <= size - position - 8 && checksum(data + position + 8, header[0]) == header[1]) {
+            return 8 + header[0];
+        }
+        if (size - position > FrameFormat::maxTornBytes || (header[0] <= size - position - 8 && position + 8 + header[0] < size)) {
+            throw std::runtime_error(path + " is corrupted, record " + std::to_string(record) + " at byte " + std::to_string(position) + " is damaged");
+        }
+        return 0;
+    }
 
-                    // Display a list of available TextFileStep objects and let the user choose
-                    std::cout << "Text files:\n";
-                    for (int i = 0; i < currentFlowTextFileSteps.size(); i++) {
-                        std::cout << i + 1 << ". " << currentFlowTextFileSteps[i]->getName() << "\n";
-                    }
 
-                    // Display a list of available CsvFileStep objects and let the user choose
-                    std::cout << "Csv files:\n";
-                    for (int i = 0; i < currentFlowCsvFileSteps.size(); i++) {
-                        std::cout << i + 1 + currentFlowTextFileSteps.size() << ". " << currentFlowCsvFileSteps[i]->getName() << "\n";
-                    }
+    // Reads back every complete record of a journal
+    // A record cut off at the end of the file was being written when the program stopped, it is left out.
+    // A record that is damaged anywhere else means the journal is corrupted, which is reported
+    // instead of dropping the records after it
+    static std::vector<RecordedRun> read(const std::string& path) {
+        MappedFile file(path);
+        const char* data = file.getData();
+        size_t size = file.getSize();
 
-                    // Get the user's choice
-                    std::cout << "Enter your choice: ";
-                    std::string fileChoice;
-                    getline(std::cin, fileChoice);
+        SnapshotReader header(data, size, version);
+        for (size_t i = 0; i < sizeof(magic); i++) {
+            if (header.readU8() != static_cast<uint8_t>(magic[i])) {
+                throw std::runtime_error(path + " is not a run journal");
+            }
+        }
+        uint32_t fileVersion = header.readU32();
+        if (fileVersion < 1 || fileVersion > version) {
+            throw std::runtime_error(path + " was written by an unsupported version");
+        }
 
-                    // Verify that the user entered a valid number and within acceptable range
-                    if (std::stoi(fileChoice) >= 1 && std::stoi(fileChoice) <= currentFlowTextFileSteps.size()) {
-                        // First if is for text files
-                        displayContentsOfFile(currentFlowTextFileSteps[std::stoi(fileChoice) - 1]->getName());
-                        return; // Exit and continue with the next step
-                    } else if (std::stoi(fileChoice) >= currentFlowTextFileSteps.size() + 1 && std::stoi(fileChoice) <= currentFlowTextFileSteps.size() + currentFlowCsvFileSteps.size()) {
-                        // This if is for csv files
-                        displayContentsOfFile(currentFlowCsvFileSteps[std::stoi(fileChoice) - currentFlowTextFileSteps.size() - 1]->getName());
-                        return; // Exit and continue with the next step
-                    } else { // Invalid choice
-                        std::cout << "Invalid choice! Please try again.\n";
-                        addErrorAtIndex(1); // Error on the second screen
-                    }
+        FrameFormat frames(frameMagic, fileVersion >= 3 ? header.readU32() : 0);
+
+        std::vector<RecordedRun> runs;
+        size_t position = headerSize(fileVersion);
+        const size_t frameHeader = fileVersion >= 3 ? FrameFormat::headerSize : 8;
+        while (size - position >= frameHeader) {
+            size_t frame;
+            if (fileVersion >= 3) {
+                frame = frames.frameAt(data, size, position, runs.size());
+                if (frame == 0 && frames.hasFramesAfter(data, size, position, runs.size())) {
+                    throw std::runtime_error(path + " is corrupted, record " + std::to_string(runs.size() + 1) + " at byte "
+                        + std::to_string(position) + " is damaged");
                 }
-            } else if (choice == "2") { // Skip the step
-                std::cout << "Skipping this step...\n";
-                addSkip();
-                break;
-            } else { // Invalid choice
-                std::cout << "Invalid choice! Please try again.\n";
-                addErrorAtIndex(0); // Error on the first screen
+            } else {
+                frame = legacyFrameAt(path, data, size, position, runs.size() + 1);
+            }
+            if (frame == 0) {
+                break; // Torn by a crash
             }
+            const char* record = data + position + frameHeader;
+            size_t recordSize = frame - frameHeader;
+            position += frame;
+
+            RecordedRun run;
+            SnapshotReader in(record, recordSize, fileVersion);
+            run.flowName = in.readString();
+            if (fileVersion >= 2) {
+                run.definition = in.readU64();
+            }
+            run.startedAt = in.readU64();
+            while (!in.atEnd()) {
+                switch (static_cast<JournalEvent>(in.readU8())) {
+                case JournalEvent::Step:
+                    in.readU8();
+                    break;
+                case JournalEvent::Answer:
+                    in.readU8();
+                    run.answers.push_back(in.readString());
+                    break;
+                case JournalEvent::Error:
+                    in.readU8();
+                    break;
+                case JournalEvent::Skip:
+                    break;
+                case JournalEvent::Result:
+                    in.skipString();
+                    break;
+                case JournalEvent::End:
+                    run.duration = in.readU64();
+                    run.completed = in.readU8() != 0;
+                    break;
+                default:
+                    throw std::runtime_error(path + " contains an unknown event");
+                }
+            }
+            runs.push_back(std::move(run));
         }
+        return runs;
+    }
+};
+
+
+class Step;
+template <typename T>
+class NumberInput;
+template <typename T>
+class CalculusStep;
+class TextFileStep;
+class CsvFileStep;
+class ColumnAggregateStep;
+
+
+// The first steps of one of the lists a flow keeps, the ones a run has reached so far
+template <typename T>
+class StepList {
+private:
+    const std::vector<T*>* items = nullptr;
+    size_t count = 0; // How many of the items were reached
+
+public:
+    // Starts a new run over a list, nothing is reached yet
+    void reset(const std::vector<T*>& items) {
+        this->items = &items;
+        count = 0;
+    }
+
+
+    // The next item of the list was reached
+    void reveal() {
+        count++;
+    }
+
+
+    size_t size() const {
+        return count;
+    }
+
+
+    T* operator[](size_t index) const {
+        return (*items)[index];
+    }
+
+
+    typename std::vector<T*>::const_iterator begin() const {
+        return items->begin();
+    }
+
+
+    typename std::vector<T*>::const_iterator end() const {
+        return items->begin() + count;
     }
 };
 
 
-class OutputStep : public Step {
+// The number inputs and calculus steps of one number type a run has reached so far
+template <typename T>
+struct NumberSteps {
+    StepList<NumberInput<T>> inputs;
+    StepList<CalculusStep<T>> calculusSteps;
+};
+
+
+// Writes a duration in nanoseconds with a readable unit
+std::string formatDuration(uint64_t nanos) {
+    char text[32];
+    if (nanos < 1000) {
+        snprintf(text, sizeof(text), "%lluns", (unsigned long long)nanos);
+    } else if (nanos < 1000000) {
+        snprintf(text, sizeof(text), "%.1fus", nanos / 1e3);
+    } else if (nanos < 1000000000) {
+        snprintf(text, sizeof(text), "%.1fms", nanos / 1e6);
+    } else {
+        snprintf(text, sizeof(text), "%.2fs", nanos / 1e9);
+    }
+    return text;
+}
+
+
+// Histogram of durations in nanoseconds that many runs can record to at the same time without a lock
+// Durations under 16ns get a bucket each, above that every power of two is split into 16 buckets,
+// so a percentile is never off by more than about 3%. Recording is one relaxed atomic add
+class LatencyHistogram {
 private:
-    std::string title;
-    std::string description;
-    std::string previousInfo;
-    
-    void displayContentsOfFile(std::string name, std::string file) {
-        std::ifstream inputFile(name);
-        std::ofstream outputFile(file, std::ios::app); // Open file in append mode
+    static const int subBits = 4;
+    static const int subCount = 1 << subBits;
+    static const int maxBits = 44; // Anything longer than about 4.8 hours goes to the last bucket
+    static const int bucketCount = (maxBits - subBits + 1) * subCount;
 
-        if (!inputFile.is_open()) { // Check if the file was opened successfully
-            outputFile << "Error opening file: " << name << "\n";
-            return;
+    std::atomic<uint32_t> counts[bucketCount] = {};
+
+
+    static int bucketOf(uint64_t nanos) {
+        if (nanos < subCount) {
+            return nanos;
+        }
+        if (nanos >= (uint64_t(1) << maxBits)) {
+            nanos = (uint64_t(1) << maxBits) - 1;
         }
+        int magnitude = 63 - __builtin_clzll(nanos);
+        int sub = (nanos >> (magnitude - subBits)) & (subCount - 1);
+        return (magnitude - subBits + 1) * subCount + sub;
+    }
 
-        if (!outputFile.is_open()) { // Check if the file was opened successfully
-            outputFile << "Error creating/opening file: " << file << "\n";
-            return;
+
+    // Returns the middle of the durations that fall into a bucket
+    static uint64_t middleOf(int bucket) {
+        if (bucket < subCount) {
+            return bucket;
         }
+        int magnitude = bucket / subCount + subBits - 1;
+        uint64_t width = uint64_t(1) << (magnitude - subBits);
+        uint64_t low = uint64_t(subCount + bucket % subCount) << (magnitude - subBits);
+        return low + width / 2;
+    }
 
-        // Display the contents of the file line by line
-        std::string line;
-        while (std::getline(inputFile, line)) {
-            outputFile << line << "\n";
+public:
+    void record(uint64_t nanos) {
+        counts[bucketOf(nanos)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+
+    // Returns how many durations were recorded
+    uint64_t count() const {
+        uint64_t total = 0;
+        for (int i = 0; i < bucketCount; i++) {
+            total += counts[i].load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+
+    // Returns the duration that the given fraction of the recorded durations do not exceed, 0 if nothing was recorded
+    uint64_t percentile(double fraction) const {
+        uint64_t total = count();
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t rank = std::max<uint64_t>(1, std::ceil(fraction * total));
+        uint64_t seen = 0;
+        for (int i = 0; i < bucketCount; i++) {
+            seen += counts[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return middleOf(i);
+            }
+        }
+        return middleOf(bucketCount - 1);
+    }
+
+
+    // Writes the count and the p50, p99 and p999 of the histogram on one line
+    void display(std::ostream& out) const {
+        out << count() << " times, p50 " << formatDuration(percentile(0.5));
+        out << ", p99 " << formatDuration(percentile(0.99));
+        out << ", p999 " << formatDuration(percentile(0.999)) << "\n";
+    }
+};
+
+
+// How long a step took to run, as a whole and on each of its screens
+// A screen is timed from the moment the step or the previous screen finished until its answer was read
+struct StepTimings {
+    LatencyHistogram execute;
+    LatencyHistogram screens[3];
+};
+
+
+// Where the state of every step of a flow goes inside the state block of a run
+// The layout is worked out once, as the steps are added to the flow, and is shared by all of its runs
+class StateLayout {
+public:
+    struct Part {
+        size_t offset;
+        void (*construct)(char* memory);
+        void (*destroy)(char* memory);
+    };
+
+private:
+    std::vector<Part> parts;
+    size_t size = 0;
+
+public:
+    // Makes room for one more state at the end of the block, returns where it starts
+    size_t add(size_t partSize, size_t alignment, void (*construct)(char*), void (*destroy)(char*)) {
+        size_t offset = (size + alignment - 1) & ~(alignment - 1);
+        parts.push_back(Part{offset, construct, destroy});
+        size = offset + partSize;
+        return offset;
+    }
+
+
+    // Returns the number of bytes a run needs for the states
+    size_t getSize() const {
+        return size;
+    }
+
+
+    const std::vector<Part>& getParts() const {
+        return parts;
+    }
+};
+
+
+// Everything a single execution of a flow keeps track of
+// Every run gets its own context, so several runs can execute at the same time on different threads
+class RunContext {
+private:
+    StepIO& io; // Where the answers come from
+    StepTimings* timings = nullptr; // Where the screens of the running step are timed
+    uint64_t screenStart = 0; // When the current screen of the running step started
+    RunJournal* journal; // Where the record of the run goes, nullptr if runs aren't journaled
+    SnapshotWriter record; // The record of the run so far
+    uint64_t runStart = 0; // When the run started, to measure its duration
+    const StateLayout* layout = nullptr; // The states constructed in the block, nullptr if there are none
+    std::unique_ptr<char[]> stateBlock; // What the steps entered in this run, kept for the next run of the context
+    size_t stateCapacity = 0;
+    std::vector<PendingReport> pendingReports; // Reports written in the background during this run
+
+public:
+    // The lists are views over the indexes the flow builds when it is defined
+    StepList<Step> steps; // All steps reached so far
+    NumberSteps<float> floats; // NumberInputStep and CalculusStep objects reached so far, one set per number type
+    NumberSteps<int64_t> integers;
+    NumberSteps<double> doubles;
+    NumberSteps<Decimal> decimals;
+    StepList<TextFileStep> textFileSteps; // TextFileStep objects reached so far
+    StepList<CsvFileStep> csvFileSteps; // CsvFileStep objects reached so far
+    StepList<ColumnAggregateStep> aggregateSteps; // ColumnAggregateStep objects reached so far
+
+    RunContext(StepIO& io, RunJournal* journal = nullptr) : io(io), journal(journal) {}
+    RunContext(const RunContext&) = delete;
+    RunContext& operator=(const RunContext&) = delete;
+
+
+    ~RunContext() {
+        clearState();
+    }
+
+
+    // Constructs a fresh state for every step of a flow, the states of the previous run are dropped
+    void resetState(const StateLayout& layout) {
+        clearState();
+        if (layout.getSize() > stateCapacity) {
+            stateBlock.reset(new char[layout.getSize()]); // new char[] is aligned for any state
+            stateCapacity = layout.getSize();
+        }
+        for (auto& part : layout.getParts()) {
+            part.construct(stateBlock.get() + part.offset);
+        }
+        this->layout = &layout;
+    }
+
+
+    // Destroys the states of the current run, in the opposite order they were constructed in
+    void clearState() {
+        if (layout == nullptr) {
+            return;
+        }
+        const std::vector<StateLayout::Part>& parts = layout->getParts();
+        for (auto part = parts.rbegin(); part != parts.rend(); part++) {
+            part->destroy(stateBlock.get() + part->offset);
+        }
+        layout = nullptr;
+    }
+
+
+    // Returns the state that starts at the given offset of the block
+    char* stateAt(size_t offset) {
+        return stateBlock.get() + offset;
+    }
+
+
+    // Returns the steps reached so far that work with numbers of type T
+    template <typename T>
+    NumberSteps<T>& numbers() {
+        if constexpr (std::is_same_v<T, float>) {
+            return floats;
+        } else if constexpr (std::is_same_v<T, int64_t>) {
+            return integers;
+        } else if constexpr (std::is_same_v<T, double>) {
+            return doubles;
+        } else {
+            return decimals;
+        }
+    }
+
+
+    // A new step starts at the given time, its screens are timed into the given timings
+    void beginStep(StepTimings* timings, uint64_t start) {
+        this->timings = timings;
+        screenStart = start;
+    }
+
+
+    // Reads the next answer of this run, the time it took is added to the given screen (index)
+    bool readLine(std::string& line, int screen) {
+        bool read = io.readLine(line);
+        if (timings != nullptr) {
+            uint64_t now = monotonicNanos();
+            timings->screens[screen].record(now - screenStart);
+            screenStart = now;
+        }
+        if (journal != nullptr && read) {
+            record.writeU8(static_cast<uint8_t>(JournalEvent::Answer));
+            record.writeU8(screen);
+            record.writeString(line);
+        }
+        return read;
+    }
+
+
+    // Returns true if the run is recorded in a journal
+    bool isJournaled() {
+        return journal != nullptr;
+    }
+
+
+    // Starts the record of the run, the definition hash tells apart flows that have the same name
+    void startRun(const std::string& flowName, uint64_t definition) {
+        if (journal == nullptr) {
+            return;
+        }
+        record.clear();
+        record.writeString(flowName);
+        if (journal->getVersion() >= 2) {
+            record.writeU64(definition);
+        }
+        record.writeU64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+        runStart = monotonicNanos();
+    }
+
+
+    // Records that the next step of the run starts
+    void recordStep(uint8_t kind) {
+        if (journal != nullptr) {
+            record.writeU8(static_cast<uint8_t>(JournalEvent::Step));
+            record.writeU8(kind);
+        }
+    }
+
+
+    // Records an answer rejected on the given screen (index) of the running step
+    void recordError(int screen) {
+        if (journal != nullptr) {
+            record.writeU8(static_cast<uint8_t>(JournalEvent::Error));
+            record.writeU8(screen);
+        }
+    }
+
+
+    // Records that the running step was skipped
+    void recordSkip() {
+        if (journal != nullptr) {
+            record.writeU8(static_cast<uint8_t>(JournalEvent::Skip));
+        }
+    }
+
+
+    // Records what the running step produced
+    void recordResult(const std::string& result) {
+        if (journal != nullptr) {
+            record.writeU8(static_cast<uint8_t>(JournalEvent::Result));
+            record.writeString(result);
+        }
+    }
+
+
+    // Ends the record of the run and hands it to the journal
+    void finishRun(bool completed) {
+        if (journal == nullptr) {
+            return;
+        }
+        record.writeU8(static_cast<uint8_t>(JournalEvent::End));
+        record.writeU64(monotonicNanos() - runStart);
+        record.writeU8(completed);
+        journal->append(record.getBuffer());
+    }
+
+
+    // Remembers a report that is still being written in the background
+    void addPendingReport(PendingReport report) {
+        pendingReports.push_back(std::move(report));
+    }
+
+
+    // Waits until the reports of this run are written, the ones that couldn't be are reported on the screen
+    void awaitReports() {
+        for (auto& report : pendingReports) {
+            report.writer->wait(report.ticket);
+            if (report.failed->load(std::memory_order_relaxed)) {
+                out() << "Error writing file: " << report.name << "\n";
+            }
+        }
+        pendingReports.clear();
+    }
+
+
+    // Returns the stream the prompts of this run are written to
+    std::ostream& out() {
+        return io.out();
+    }
+};
+
+
+// Gives access to the lines of a file of any size
+// The file is memory mapped and the start of every checkpointInterval-th line is remembered
+// as the file is scanned, so finding any line costs one lookup and a scan of at most
+// checkpointInterval lines, and the index stays small even for files with billions of lines
+// The file is only scanned as far as the lines that were asked for
+class PagedFile {
+private:
+    static const size_t checkpointInterval = 1024;
+    static const size_t releaseInterval = 64 << 20; // Scanned pages are dropped every 64 MiB
+
+    std::shared_ptr<MappedFile> file; // Shared with every other user of the file through the file cache
+    std::vector<uint64_t> checkpoints; // checkpoints[i] is the offset of line i * checkpointInterval
+    size_t scannedLines = 0; // Number of lines scanned so far
+    size_t scanOffset = 0; // Offset of the first line that wasn't scanned yet
+    size_t releasedUpTo = 0; // Everything before this offset was released from memory
+
+    // Returns the offset of the line after the one starting at offset
+    size_t nextLine(size_t offset) {
+        const char* data = file->getData();
+        const char* end = static_cast<const char*>(memchr(data + offset, '\n', file->getSize() - offset));
+        return end == nullptr ? file->getSize() : end - data + 1;
+    }
+
+
+    // Scans the file until the given line or the end of the file is reached
+    void scanTo(size_t line) {
+        while (scannedLines <= line && scanOffset < file->getSize()) {
+            if (scannedLines % checkpointInterval == 0) {
+                checkpoints.push_back(scanOffset);
+            }
+            scanOffset = nextLine(scanOffset);
+            scannedLines++;
+
+            // Scanning a huge file shouldn't keep all of it in memory
+            if (scanOffset - releasedUpTo >= releaseInterval) {
+                file->release(releasedUpTo, scanOffset - releasedUpTo);
+                releasedUpTo = scanOffset / 4096 * 4096;
+            }
+        }
+    }
+
+public:
+    PagedFile(std::string name) : file(FileCache::shared().acquire(name)) {
+        file->adviseSequential(0, file->getSize()); // The file is scanned from the start
+    }
+
+
+    // Returns true if the file has the given line (counting from 0)
+    bool hasLine(size_t line) {
+        scanTo(line);
+        return line < scannedLines;
+    }
+
+
+    // Returns the offset of a line (counting from 0), or the size of the file if there's no such line
+    size_t lineOffset(size_t line) {
+        if (!hasLine(line)) {
+            return file->getSize();
+        }
+
+        // Start at the closest checkpoint and skip the remaining lines
+        size_t offset = checkpoints[line / checkpointInterval];
+        for (size_t i = line / checkpointInterval * checkpointInterval; i < line; i++) {
+            offset = nextLine(offset);
+        }
+        return offset;
+    }
+
+
+    // Writes the lines [first, first + count) on the screen, returns how many were written
+    size_t writeLines(std::ostream& out, size_t first, size_t count) {
+        const char* data = file->getData();
+        size_t offset = lineOffset(first);
+        size_t written = 0;
+
+        while (written < count && offset < file->getSize()) {
+            size_t next = nextLine(offset);
+            size_t length = next - offset;
+            if (data[next - 1] == '\n') {
+                length--; // The line break is written separately, the last line might not have one
+            }
+            out.write(data + offset, length);
+            out << "\n";
+            offset = next;
+            written++;
+        }
+
+        return written;
+    }
+};
+
+
+// Buffered writer for one output file
+// The file is opened once and everything written goes through a large buffer,
+// so a whole report costs a handful of write calls instead of an open and close per step
+// Given a WriteBehind, full buffers are handed to it instead of being written, and the file is closed by it
+// A background writer can also compress the file and continue it in a new file every few bytes (see ReportFormat)
+// The report stays open for this writer alone until it is closed, see ReportFile
+class OutputWriter : private std::streambuf {
+private:
+    std::shared_ptr<ReportFile> report; // Null once the writer is closed
+    std::unique_ptr<char[]> buffer; // Left uninitialized, only the part that gets written is touched
+    size_t bufferSize;
+    std::ostream stream; // Formats the values written with <<
+    WriteBehind* behind; // Null if the file is written right away
+    ReportFormat format; // Only used with a background writer
+    uint64_t ticket = 0; // Ticket of the last block handed to the background writer
+    std::shared_ptr<std::atomic<bool>> failed = std::make_shared<std::atomic<bool>>(false);
+
+    // Called by the stream when the buffer is full
+    int overflow(int c) override {
+        if (!flush()) {
+            return traits_type::eof();
+        }
+        if (c != traits_type::eof()) {
+            *pptr() = static_cast<char>(c);
+            pbump(1);
+        }
+        return c;
+    }
+
+
+    // Called by the stream on std::flush
+    int sync() override {
+        return flush() ? 0 : -1;
+    }
+
+
+    // Hands a block to the background writer, which moves the report on to its next part once one is full
+    void submit(WriteBehind::Block block) {
+        block.file = report;
+        block.compression = format.compression;
+        block.failed = failed;
+        ticket = behind->submit(std::move(block));
+    }
+
+
+    // Writes bytes straight to the file, retrying on partial writes
+    bool writeAll(const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t count = ::write(report->getFd(), data, size);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                failed->store(true, std::memory_order_relaxed);
+                return false;
+            }
+            data += count;
+            size -= count;
+        }
+        return true;
+    }
+
+public:
+    OutputWriter(std::string name, size_t bufferSize = 1 << 20, WriteBehind* behind = nullptr, ReportFormat format = ReportFormat())
+        : buffer(behind != nullptr ? behind->takeBuffer(bufferSize) : std::unique_ptr<char[]>(new char[bufferSize])), bufferSize(bufferSize),
+          stream(this), behind(behind), format(behind != nullptr ? format : ReportFormat()) {
+        report = std::make_shared<ReportFile>(name, this->format);
+        setp(buffer.get(), buffer.get() + bufferSize);
+        if (report->getFd() < 0) {
+            report.reset(); // Closes it, so the next writer of the report can try
+            stream.setstate(std::ios::badbit); // Nothing gets written to a file that couldn't be opened
+        }
+    }
+
+
+    ~OutputWriter() {
+        close();
+    }
+
+
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+
+
+    // Returns true if the file was opened
+    bool isOpen() {
+        return report != nullptr;
+    }
+
+
+    // Returns the stream used to write into the file
+    std::ostream& out() {
+        return stream;
+    }
+
+
+    // Appends raw bytes, large blocks skip the buffer
+    void write(const char* data, size_t size) {
+        if (size >= bufferSize && behind == nullptr) {
+            flush();
+            writeAll(data, size);
+            return;
+        }
+        stream.write(data, size);
+    }
+
+
+    // Appends a whole mapped file, the background writer writes straight from the mapping
+    // A file that is compressed or rotated is handed over in slices, so they can be compressed at the same time
+    // and a new file can start between them, a slice is never larger than a whole part
+    void write(std::shared_ptr<MappedFile> file) {
+        if (behind == nullptr || report == nullptr || file->getSize() < bufferSize) {
+            write(file->getData(), file->getSize());
+            return;
+        }
+        flush();
+        size_t sliceSize = format.compression > 0 || format.rotateBytes > 0 ? 4 * WriteBehind::blockSize : file->getSize();
+        if (format.rotateBytes > 0) {
+            sliceSize = std::min<uint64_t>(sliceSize, std::max<uint64_t>(format.rotateBytes, bufferSize));
+        }
+        for (size_t offset = 0; offset < file->getSize(); offset += sliceSize) {
+            WriteBehind::Block block;
+            block.data = file->getData() + offset;
+            block.size = std::min(sliceSize, file->getSize() - offset);
+            block.mapping = file;
+            submit(std::move(block));
+        }
+    }
+
+
+    // Writes everything buffered so far to the file, or hands it to the background writer
+    bool flush() {
+        if (report == nullptr) {
+            return false;
+        }
+        size_t pending = pptr() - pbase();
+        bool written = true;
+        if (behind == nullptr) {
+            written = writeAll(pbase(), pending);
+        } else if (pending > 0) {
+            WriteBehind::Block block;
+            block.data = buffer.get();
+            block.size = pending;
+            block.capacity = bufferSize;
+            block.buffer = std::move(buffer);
+            buffer = behind->takeBuffer(bufferSize);
+            submit(std::move(block));
+        }
+        setp(buffer.get(), buffer.get() + bufferSize);
+        return written && !failed->load(std::memory_order_relaxed);
+    }
+
+
+    // Flushes and closes the file, with a background writer both happen once it wrote what was handed over
+    // The next writer of the same report can only open it then
+    void close() {
+        if (report == nullptr) {
+            return;
+        }
+        flush();
+        if (behind == nullptr) {
+            report->close();
+        } else {
+            WriteBehind::Block block;
+            block.closeAfter = true;
+            submit(std::move(block));
+        }
+        report.reset();
+    }
+
+
+    // Returns what has to be waited for until the file is written, after close
+    PendingReport getPending(std::string name) {
+        return PendingReport{name, behind, ticket, failed};
+    }
+};
+
+
+// Writes a whole file to a temporary file first and renames it over the old one,
+// so a crash never leaves half a file behind and readers always see a complete one
+void replaceFile(const std::string& path, const std::string& data) {
+    std::string temporary = path + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Error opening file: " + temporary);
+    }
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t count = write(fd, data.data() + done, data.size() - done);
+        if (count < 0) {
+            close(fd);
+            throw std::runtime_error("Error writing file: " + temporary);
+        }
+        done += count;
+    }
+    fsync(fd);
+    close(fd);
+
+    if (rename(temporary.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Error replacing file: " + path);
+    }
+}
+
+
+// The types a csv column can have, from the most to the least specific
+// A column gets the least specific type of all the fields that were sampled
+enum class CsvType : uint8_t {
+    Empty,
+    Integer,
+    Decimal,
+    Text
+};
+
+
+// Returns the name of a csv column type
+std::string csvTypeName(CsvType type) {
+    switch (type) {
+    case CsvType::Empty: return "empty";
+    case CsvType::Integer: return "integer";
+    case CsvType::Decimal: return "decimal";
+    default: return "text";
+    }
+}
+
+
+// Detects the type of a single unquoted field
+CsvType classifyCsvField(const char* data, size_t size) {
+    if (size == 0) {
+        return CsvType::Empty;
+    }
+
+    size_t i = 0;
+    if (data[i] == '-' || data[i] == '+') {
+        i++;
+    }
+
+    size_t digits = 0;
+    bool dot = false;
+    bool exponent = false;
+    for (; i < size; i++) {
+        char c = data[i];
+        if (c >= '0' && c <= '9') {
+            digits++;
+        } else if (c == '.' && !dot && !exponent) {
+            dot = true;
+        } else if ((c == 'e' || c == 'E') && digits > 0 && !exponent) {
+            exponent = true;
+            if (i + 1 < size && (data[i + 1] == '-' || data[i + 1] == '+')) {
+                i++;
+            }
+            if (i + 1 >= size) {
+                return CsvType::Text; // Nothing after the exponent
+            }
+        } else {
+            return CsvType::Text;
+        }
+    }
+
+    if (digits == 0) {
+        return CsvType::Text;
+    }
+    return dot || exponent ? CsvType::Decimal : CsvType::Integer;
+}
+
+
+// Parsed view of a csv file (RFC 4180: comma separated, fields may be quoted, "" is an escaped quote)
+// The file is memory mapped and scanned once: the start of every row is indexed, the number of
+// columns is counted and the type of every column is detected from the first rows
+// The fields themselves are not copied, they are read from the mapping when asked for
+class CsvTable {
+private:
+    static const size_t sampleRows = 4096; // Rows used to detect the column types
+
+    std::shared_ptr<MappedFile> file; // Shared with every other user of the file through the file cache
+    std::vector<uint64_t> rowOffsets; // Start of every row
+    std::vector<CsvType> columnTypes;
+    bool header = false; // True if the first row names the columns
+    std::vector<CsvType> sampleTypes; // Types seen in the sampled rows after the first one
+    std::vector<CsvType> firstRowTypes; // Types of the fields of the first row
+
+    // State of the scan
+    bool inQuotes = false;
+    bool quotedField = false;
+    size_t fieldStart = 0;
+    size_t column = 0;
+    size_t rowStart = 0;
+    size_t skipUntil = 0; // Structural characters before this offset were already handled
+
+    // Remembers the type of a field of one of the sampled rows
+    void sampleField(size_t end) {
+        if (rowOffsets.size() >= sampleRows) {
+            return;
+        }
+
+        // Fields are sampled per row, the header decision is made at the end
+        if (column >= sampleTypes.size()) {
+            sampleTypes.resize(column + 1, CsvType::Empty);
+            firstRowTypes.resize(column + 1, CsvType::Empty);
+        }
+
+        const char* data = file->getData() + fieldStart;
+        size_t size = end - fieldStart;
+        if (size > 0 && data[size - 1] == '\r') {
+            size--; // Lines ending with \r\n
+        }
+
+        CsvType type;
+        if (quotedField && size >= 2 && data[0] == '"' && data[size - 1] == '"') {
+            type = classifyCsvField(data + 1, size - 2);
+        } else {
+            type = classifyCsvField(data, size);
+        }
+
+        if (rowOffsets.empty()) {
+            firstRowTypes[column] = type;
+        } else if (type > sampleTypes[column]) {
+            sampleTypes[column] = type;
+        }
+    }
+
+
+    // Ends the current field at the given offset
+    void endField(size_t end) {
+        sampleField(end);
+        column++;
+        if (column > columnTypes.size()) {
+            columnTypes.resize(column, CsvType::Empty);
+        }
+        fieldStart = end + 1;
+        quotedField = false;
+    }
+
+
+    // Ends the current row at the given offset (the line break)
+    void endRow(size_t end) {
+        // A blank line isn't a row
+        bool blank = end == rowStart || (end == rowStart + 1 && file->getData()[rowStart] == '\r');
+        if (blank && column == 0) {
+            fieldStart = rowStart = end + 1;
+            return;
+        }
+
+        endField(end);
+        rowOffsets.push_back(rowStart);
+        column = 0;
+        rowStart = end + 1;
+    }
+
+
+    // Handles one structural character (comma, quote or line break)
+    void handle(size_t position) {
+        char c = file->getData()[position];
+        if (inQuotes) {
+            if (c == '"') {
+                // A doubled quote is an escaped quote, otherwise the quoted part ends here
+                if (position + 1 < file->getSize() && file->getData()[position + 1] == '"') {
+                    skipUntil = position + 2;
+                } else {
+                    inQuotes = false;
+                }
+            }
+        } else if (c == ',') {
+            endField(position);
+        } else if (c == '\n') {
+            endRow(position);
+        } else if (c == '"') {
+            inQuotes = true;
+            quotedField = true;
+        }
+    }
+
+
+    // Ends a row found by the fast scan, commas is the number of separators it had
+    void endFastRow(size_t end, size_t commas) {
+        const char* data = file->getData();
+        bool blank = end == rowStart || (end == rowStart + 1 && data[rowStart] == '\r');
+        if (!blank) {
+            rowOffsets.push_back(rowStart);
+            if (commas + 1 > columnTypes.size()) {
+                columnTypes.resize(commas + 1, CsvType::Empty);
+            }
+        }
+        rowStart = end + 1;
+    }
+
+
+    // Returns a mask where every bit between an opening and a closing quote is set
+    // Escaped quotes ("") close and reopen the quoted part right away, so they need no special care
+    static uint64_t insideQuotes(uint64_t quotes) {
+        quotes ^= quotes << 1;
+        quotes ^= quotes << 2;
+        quotes ^= quotes << 4;
+        quotes ^= quotes << 8;
+        quotes ^= quotes << 16;
+        quotes ^= quotes << 32;
+        return quotes;
+    }
+
+
+    // Indexes the rows after the sample, 64 bytes at a time and without looking at single fields:
+    // the quoted parts are found with a prefix xor over the quote mask, then every line break
+    // outside of them ends a row and the commas before it give the number of columns
+    void scanRows(size_t position) {
+        const char* data = file->getData();
+        size_t size = file->getSize();
+        uint64_t carry = 0; // All ones if the previous block ended inside quotes
+        size_t commas = 0; // Commas seen in the current row
+
+#ifdef __SSE2__
+        const __m128i comma = _mm_set1_epi8(',');
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i newline = _mm_set1_epi8('\n');
+        for (; position + 64 <= size; position += 64) {
+            uint64_t commaMask = 0;
+            uint64_t quoteMask = 0;
+            uint64_t newlineMask = 0;
+            for (int part = 0; part < 4; part++) {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position + part * 16));
+                commaMask |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, comma)))) << (part * 16);
+                quoteMask |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote)))) << (part * 16);
+                newlineMask |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)))) << (part * 16);
+            }
+
+            uint64_t inside = insideQuotes(quoteMask) ^ carry;
+            carry = static_cast<uint64_t>(static_cast<int64_t>(inside) >> 63);
+            commaMask &= ~inside;
+            newlineMask &= ~inside;
+
+            while (newlineMask != 0) {
+                int bit = __builtin_ctzll(newlineMask);
+                uint64_t before = (uint64_t(1) << bit) - 1;
+                commas += __builtin_popcountll(commaMask & before);
+                commaMask &= ~before;
+                endFastRow(position + bit, commas);
+                commas = 0;
+                newlineMask &= newlineMask - 1;
+            }
+            commas += __builtin_popcountll(commaMask);
+        }
+#endif
+
+        // What is left (or everything, without SSE2) one byte at a time
+        bool quoted = carry != 0;
+        for (; position < size; position++) {
+            char c = data[position];
+            if (c == '"') {
+                quoted = !quoted;
+            } else if (!quoted && c == ',') {
+                commas++;
+            } else if (!quoted && c == '\n') {
+                endFastRow(position, commas);
+                commas = 0;
+            }
+        }
+
+        if (quoted) {
+            throw std::runtime_error("Malformed csv file, a quoted field is never closed");
+        }
+
+        // The last row might not end with a line break
+        if (rowStart < size) {
+            endFastRow(size, commas);
+        }
+    }
+
+
+    // Scans the whole file once
+    // The first rows are split into fields to detect the column types, the rest is only indexed
+    void scan() {
+        const char* data = file->getData();
+        size_t size = file->getSize();
+        size_t position = 0;
+
+        for (; position < size && rowOffsets.size() < sampleRows; position++) {
+            char c = data[position];
+            if ((c == ',' || c == '"' || c == '\n') && position >= skipUntil) {
+                handle(position);
+            }
+        }
+
+        if (rowOffsets.size() >= sampleRows) {
+            scanRows(rowStart); // The sample always stops right after a line break
+            return;
+        }
+
+        if (inQuotes) {
+            throw std::runtime_error("Malformed csv file, a quoted field is never closed");
+        }
+
+        // The last row might not end with a line break
+        if (rowStart < size) {
+            endRow(size);
+        }
+    }
+
+
+    // Decides on the column types once the sample is complete
+    void detectTypes() {
+        // If every field of the first row is text but some column holds numbers, the first row is a header
+        bool firstRowText = !firstRowTypes.empty();
+        for (auto type : firstRowTypes) {
+            if (type != CsvType::Text) {
+                firstRowText = false;
+            }
+        }
+        bool numbers = false;
+        for (auto type : sampleTypes) {
+            if (type == CsvType::Integer || type == CsvType::Decimal) {
+                numbers = true;
+            }
+        }
+        header = firstRowText && numbers && rowOffsets.size() > 1;
+
+        for (size_t i = 0; i < columnTypes.size(); i++) {
+            CsvType type = i < sampleTypes.size() ? sampleTypes[i] : CsvType::Empty;
+            if (!header && i < firstRowTypes.size() && firstRowTypes[i] > type) {
+                type = firstRowTypes[i];
+            }
+            columnTypes[i] = type;
+        }
+    }
+
+public:
+    CsvTable(std::string name) : CsvTable(FileCache::shared().acquire(name)) {}
+
+
+    // Parses a file that was already mapped
+    CsvTable(std::shared_ptr<MappedFile> file) : file(file) {
+        file->adviseSequential(0, file->getSize());
+        scan();
+        detectTypes();
+    }
+
+
+    // Returns the number of rows, the header included
+    size_t getRowCount() {
+        return rowOffsets.size();
+    }
+
+
+    // Returns the number of columns of the widest row
+    size_t getColumnCount() {
+        return columnTypes.size();
+    }
+
+
+    // Returns the detected type of a column
+    CsvType getColumnType(size_t column) {
+        return columnTypes[column];
+    }
+
+
+    // Returns true if the first row holds the names of the columns
+    bool hasHeader() {
+        return header;
+    }
+
+
+    // Calls visit(column, data, size) for every field of a row until it returns false, quoted fields
+    // are passed without the surrounding quotes but with the escaped quotes still doubled
+    template <typename Visitor>
+    void forEachField(size_t row, Visitor visit) {
+        const char* data = file->getData();
+        size_t size = file->getSize();
+        size_t position = rowOffsets[row];
+        size_t column = 0;
+
+        while (true) {
+            size_t start = position;
+            if (position < size && data[position] == '"') {
+                // Find the closing quote, skipping the escaped ones
+                position++;
+                while (position < size && !(data[position] == '"' && (position + 1 >= size || data[position + 1] != '"'))) {
+                    position += data[position] == '"' ? 2 : 1;
+                }
+                if (!visit(column, data + start + 1, position - start - 1)) {
+                    return;
+                }
+                position++; // The closing quote
+                while (position < size && data[position] != ',' && data[position] != '\n') {
+                    position++;
+                }
+            } else {
+                const char* stop = static_cast<const char*>(memchr(data + position, '\n', size - position));
+                size_t lineEnd = stop == nullptr ? size : stop - data;
+                const char* comma = static_cast<const char*>(memchr(data + position, ',', lineEnd - position));
+                size_t end = comma == nullptr ? lineEnd : comma - data;
+                size_t length = end - start;
+                if (end == lineEnd && length > 0 && data[end - 1] == '\r') {
+                    length--;
+                }
+                if (!visit(column, data + start, length)) {
+                    return;
+                }
+                position = end;
+            }
+
+            if (position >= size || data[position] == '\n') {
+                return;
+            }
+            position++; // The comma
+            column++;
+        }
+    }
+
+
+    // Points data at a field straight inside the file, false if the row doesn't have that column
+    bool findField(size_t row, size_t column, const char*& data, size_t& size) {
+        bool found = false;
+        forEachField(row, [&](size_t index, const char* fieldData, size_t fieldSize) {
+            if (index == column) {
+                data = fieldData;
+                size = fieldSize;
+                found = true;
+            }
+            return index < column; // Stop once the column was reached
+        });
+        return found;
+    }
+
+
+    // Returns a field with the quoting removed, empty if the row doesn't have that column
+    std::string getField(size_t row, size_t column) {
+        std::string field;
+        const char* data;
+        size_t size;
+        if (findField(row, column, data, size)) {
+            field.reserve(size);
+            for (size_t i = 0; i < size; i++) {
+                field.push_back(data[i]);
+                if (data[i] == '"' && i + 1 < size && data[i + 1] == '"') {
+                    i++; // Escaped quote
+                }
+            }
+        }
+        return field;
+    }
+};
+
+
+// Sum, minimum, maximum and count of a column of numbers, the values are added a block at a time
+class ColumnStats {
+private:
+    double sum = 0;
+    double minimum = std::numeric_limits<double>::infinity();
+    double maximum = -std::numeric_limits<double>::infinity();
+    size_t count = 0;
+
+public:
+    // Adds a block of values, four pairs at a time with SSE2 so the additions don't wait on each other
+    void add(const double* values, size_t size) {
+        size_t i = 0;
+
+#ifdef __SSE2__
+        if (size >= 8) {
+            __m128d sums[4], mins[4], maxs[4];
+            for (int k = 0; k < 4; k++) {
+                sums[k] = _mm_setzero_pd();
+                mins[k] = _mm_set1_pd(minimum);
+                maxs[k] = _mm_set1_pd(maximum);
+            }
+            for (; i + 8 <= size; i += 8) {
+                for (int k = 0; k < 4; k++) {
+                    __m128d value = _mm_loadu_pd(values + i + k * 2);
+                    sums[k] = _mm_add_pd(sums[k], value);
+                    mins[k] = _mm_min_pd(mins[k], value);
+                    maxs[k] = _mm_max_pd(maxs[k], value);
+                }
+            }
+
+            // Fold the accumulators into the totals
+            double parts[2];
+            _mm_storeu_pd(parts, _mm_add_pd(_mm_add_pd(sums[0], sums[1]), _mm_add_pd(sums[2], sums[3])));
+            sum += parts[0] + parts[1];
+            _mm_storeu_pd(parts, _mm_min_pd(_mm_min_pd(mins[0], mins[1]), _mm_min_pd(mins[2], mins[3])));
+            minimum = std::min(parts[0], parts[1]);
+            _mm_storeu_pd(parts, _mm_max_pd(_mm_max_pd(maxs[0], maxs[1]), _mm_max_pd(maxs[2], maxs[3])));
+            maximum = std::max(parts[0], parts[1]);
+        }
+#endif
+
+        // What is left (or everything, without SSE2) one value at a time
+        for (; i < size; i++) {
+            sum += values[i];
+            minimum = std::min(minimum, values[i]);
+            maximum = std::max(maximum, values[i]);
+        }
+        count += size;
+    }
+
+
+    double getSum() {
+        return sum;
+    }
+
+
+    double getMin() {
+        return minimum;
+    }
+
+
+    double getMax() {
+        return maximum;
+    }
+
+
+    double getMean() {
+        return count == 0 ? 0 : sum / count;
+    }
+
+
+    size_t getCount() {
+        return count;
+    }
+};
+
+
+// Counters that many runs can add to at the same time without a lock
+// Every thread adds to its own shard, on its own cache line, with a relaxed atomic, and reading adds
+// the shards up. The shards are only allocated once something is counted, most steps never are
+template <size_t Count>
+class ShardedCounters {
+private:
+    static const size_t shardCount = 8;
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> values[Count] = {};
+    };
+
+    std::atomic<Shard*> shards{nullptr};
+
+
+    // Allocates the shards the first time, if two threads race the loser frees its copy
+    Shard* getShards() {
+        Shard* current = shards.load(std::memory_order_acquire);
+        if (current == nullptr) {
+            Shard* created = new Shard[shardCount];
+            if (shards.compare_exchange_strong(current, created, std::memory_order_acq_rel)) {
+                current = created;
+            } else {
+                delete[] created;
+            }
+        }
+        return current;
+    }
+
+
+    // Every thread gets a shard the first time it counts something, in turns
+    static size_t threadShard() {
+        static std::atomic<size_t> nextShard{0};
+        thread_local size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed) % shardCount;
+        return shard;
+    }
+
+public:
+    ShardedCounters() {}
+    ShardedCounters(const ShardedCounters&) = delete;
+    ShardedCounters& operator=(const ShardedCounters&) = delete;
+
+
+    ~ShardedCounters() {
+        delete[] shards.load();
+    }
+
+
+    void add(size_t counter) {
+        getShards()[threadShard()].values[counter].fetch_add(1, std::memory_order_relaxed);
+    }
+
+
+    // Returns the total of a counter over all threads
+    uint64_t get(size_t counter) const {
+        Shard* current = shards.load(std::memory_order_acquire);
+        if (current == nullptr) {
+            return 0;
+        }
+        uint64_t total = 0;
+        for (size_t i = 0; i < shardCount; i++) {
+            total += current[i].values[counter].load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+
+    // Replaces a counter, only used when nothing is running, like when loading a snapshot
+    void set(size_t counter, uint64_t value) {
+        Shard* current = getShards();
+        for (size_t i = 0; i < shardCount; i++) {
+            current[i].values[counter].store(i == 0 ? value : 0, std::memory_order_relaxed);
+        }
+    }
+};
+
+
+// Identifies every kind of step, used to sort the steps of a flow without casting
+// and to tag the steps inside the snapshot
+enum class StepKind : uint8_t {
+    Title = 1,
+    Text,
+    TextInput,
+    NumberInput,
+    Calculus,
+    TextFile,
+    CsvFile,
+    Display,
+    Output,
+    ColumnAggregate,
+    IntegerInput,
+    DoubleInput,
+    DecimalInput,
+    IntegerCalculus,
+    DoubleCalculus,
+    DecimalCalculus
+};
+
+
+// Returns the name a kind of step is exported with
+const char* stepKindName(StepKind kind) {
+    switch (kind) {
+    case StepKind::Title: return "title";
+    case StepKind::Text: return "text";
+    case StepKind::TextInput: return "text_input";
+    case StepKind::NumberInput: return "number_input";
+    case StepKind::Calculus: return "calculus";
+    case StepKind::TextFile: return "text_file";
+    case StepKind::CsvFile: return "csv_file";
+    case StepKind::Display: return "display";
+    case StepKind::Output: return "output";
+    case StepKind::ColumnAggregate: return "column_aggregate";
+    case StepKind::IntegerInput: return "integer_input";
+    case StepKind::DoubleInput: return "double_input";
+    case StepKind::DecimalInput: return "decimal_input";
+    case StepKind::IntegerCalculus: return "integer_calculus";
+    case StepKind::DoubleCalculus: return "double_calculus";
+    case StepKind::DecimalCalculus: return "decimal_calculus";
+    }
+    return "unknown";
+}
+
+
+// What the number steps need to know about the type they work with
+// The arithmetic returns false when the result can't be represented
+template <typename T>
+struct FloatingTraits {
+    static bool add(T left, T right, T& result) {
+        result = left + right;
+        return true;
+    }
+
+
+    static bool subtract(T left, T right, T& result) {
+        result = left - right;
+        return true;
+    }
+
+
+    static bool multiply(T left, T right, T& result) {
+        result = left * right;
+        return true;
+    }
+
+
+    static bool divide(T left, T right, T& result) {
+        result = left / right;
+        return true;
+    }
+
+
+    static bool fromDouble(double value, T& result) {
+        result = static_cast<T>(value);
+        return true;
+    }
+};
+
+
+template <typename T>
+struct NumberTraits;
+
+
+template <>
+struct NumberTraits<float> : FloatingTraits<float> {
+    static const StepKind inputKind = StepKind::NumberInput;
+    static const StepKind calculusKind = StepKind::Calculus;
+    static constexpr const char* name = ""; // The steps from before the other types keep their names
+};
+
+
+template <>
+struct NumberTraits<double> : FloatingTraits<double> {
+    static const StepKind inputKind = StepKind::DoubleInput;
+    static const StepKind calculusKind = StepKind::DoubleCalculus;
+    static constexpr const char* name = "double";
+};
+
+
+// Integers are exact, so overflowing is an error instead of a rounding
+template <>
+struct NumberTraits<int64_t> {
+    static const StepKind inputKind = StepKind::IntegerInput;
+    static const StepKind calculusKind = StepKind::IntegerCalculus;
+    static constexpr const char* name = "integer";
+
+
+    static bool add(int64_t left, int64_t right, int64_t& result) {
+        return !__builtin_add_overflow(left, right, &result);
+    }
+
+
+    static bool subtract(int64_t left, int64_t right, int64_t& result) {
+        return !__builtin_sub_overflow(left, right, &result);
+    }
+
+
+    static bool multiply(int64_t left, int64_t right, int64_t& result) {
+        return !__builtin_mul_overflow(left, right, &result);
+    }
+
+
+    // Truncates like C++ does, the smallest number divided by -1 doesn't fit
+    static bool divide(int64_t left, int64_t right, int64_t& result) {
+        if (left == std::numeric_limits<int64_t>::min() && right == -1) {
+            return false;
+        }
+        result = left / right;
+        return true;
+    }
+
+
+    static bool fromDouble(double value, int64_t& result) {
+        if (!(value >= -9.2e18 && value <= 9.2e18)) {
+            return false;
+        }
+        result = std::llround(value);
+        return true;
+    }
+};
+
+
+// Decimals multiply and divide through 128 bits and round half away from zero to 4 decimals
+template <>
+struct NumberTraits<Decimal> {
+    static const StepKind inputKind = StepKind::DecimalInput;
+    static const StepKind calculusKind = StepKind::DecimalCalculus;
+    static constexpr const char* name = "decimal";
+
+
+    // Divides and rounds, false if the quotient doesn't fit in a decimal
+    static bool roundedDivide(__int128 numerator, __int128 denominator, Decimal& result) {
+        if (denominator < 0) {
+            numerator = -numerator;
+            denominator = -denominator;
+        }
+        __int128 half = denominator / 2;
+        __int128 quotient = (numerator >= 0 ? numerator + half : numerator - half) / denominator;
+        if (quotient < std::numeric_limits<int64_t>::min() || quotient > std::numeric_limits<int64_t>::max()) {
+            return false;
+        }
+        result.units = static_cast<int64_t>(quotient);
+        return true;
+    }
+
+
+    static bool add(Decimal left, Decimal right, Decimal& result) {
+        return !__builtin_add_overflow(left.units, right.units, &result.units);
+    }
+
+
+    static bool subtract(Decimal left, Decimal right, Decimal& result) {
+        return !__builtin_sub_overflow(left.units, right.units, &result.units);
+    }
+
+
+    static bool multiply(Decimal left, Decimal right, Decimal& result) {
+        return roundedDivide(static_cast<__int128>(left.units) * right.units, Decimal::scale, result);
+    }
+
+
+    static bool divide(Decimal left, Decimal right, Decimal& result) {
+        return roundedDivide(static_cast<__int128>(left.units) * Decimal::scale, right.units, result);
+    }
+
+
+    static bool fromDouble(double value, Decimal& result) {
+        double units = value * Decimal::scale;
+        if (!(units >= -9.2e18 && units <= 9.2e18)) {
+            return false;
+        }
+        result.units = std::llround(units);
+        return true;
+    }
+};
+
+
+// Generic Step class template
+class Step {
+private:
+    // The number of errors for each screen, no step has more than 3 screens, then the skips
+    // Runs on several threads can count at the same time
+    ShardedCounters<4> counters;
+    static const size_t skipsCounter = 3;
+    std::atomic<StepTimings*> timings{nullptr}; // Only allocated once the step runs
+    const StepKind kind; // Set once by the child class
+
+protected:
+    Step(StepKind kind) : kind(kind) {}
+
+
+    // Adds the contents of a file to the output file, byte for byte
+    // The bytes are written from the mapping in the file cache, shared with the other steps reading the file
+    // Reports are append-only and may be compressed, so the bytes can't be moved inside the kernel
+    void addContentsFromFirstFileToSecond(std::string first, OutputWriter& second) {
+        std::shared_ptr<MappedFile> file;
+        try {
+            file = FileCache::shared().acquire(first);
+        } catch (const std::exception& e) {
+            second.out() << "Error opening file: " << first << "\n";
+            return;
+        }
+
+        size_t size = file->getSize();
+        bool lineBreak = size == 0 || file->getData()[size - 1] == '\n';
+        file->adviseSequential(0, size);
+        second.write(std::move(file));
+
+        // The report expects every file to end with a line break
+        if (!lineBreak) {
+            second.out() << "\n";
+        }
+    }
+
+public:
+    virtual ~Step() {
+        delete timings.load();
+    }
+
+
+    // Returns the latency histograms of the step, allocates them the first time, if two runs race the loser frees its copy
+    StepTimings& getTimings() {
+        StepTimings* current = timings.load(std::memory_order_acquire);
+        if (current == nullptr) {
+            StepTimings* created = new StepTimings();
+            if (timings.compare_exchange_strong(current, created, std::memory_order_acq_rel)) {
+                current = created;
+            } else {
+                delete created;
+            }
+        }
+        return *current;
+    }
+
+
+    // Returns the latency histograms of the step, or nullptr if it never ran
+    const StepTimings* findTimings() const {
+        return timings.load(std::memory_order_acquire);
+    }
+
+
+    // Add an error at a given screen (index) of the run
+    void addErrorAtIndex(RunContext& ctx, int index) {
+        counters.add(index);
+        ctx.recordError(index);
+    }
+
+
+    // Add a skip of the run
+    void addSkip(RunContext& ctx) {
+        counters.add(skipsCounter);
+        ctx.recordSkip();
+    }
+
+
+    // Returns the number of errors at a given screen (index)
+    uint64_t getErrorsAtIndex(int index) {
+        return counters.get(index);
+    }
+
+
+    // Returns the total number of errors
+    uint64_t totalErrors() {
+        return counters.get(0) + counters.get(1) + counters.get(2);
+    }
+
+
+    // Returns the number of skips
+    uint64_t getSkips() {
+        return counters.get(skipsCounter);
+    }
+
+
+    // Displays the number of errors for each screen
+    void displayErrors() {
+        for (int i = 0; i < 3; i++) {
+            std::cout << "Errors on screen " << i + 1 << ": " << counters.get(i) << "\n";
+        }
+    }
+
+
+    // Returns the kind of the step
+    StepKind getKind() {
+        return kind;
+    }
+
+
+    // Restores the counters saved in a snapshot
+    void loadCounters(uint64_t errors0, uint64_t errors1, uint64_t errors2, uint64_t skips) {
+        counters.set(0, errors0);
+        counters.set(1, errors1);
+        counters.set(2, errors2);
+        counters.set(skipsCounter, skips);
+    }
+
+
+    // Writes the kind, the counters and the parameters of the step
+    void save(SnapshotWriter& out) {
+        out.writeU8(static_cast<uint8_t>(getKind()));
+        for (int i = 0; i < 3; i++) {
+            out.writeU64(counters.get(i));
+        }
+        out.writeU64(counters.get(skipsCounter));
+        saveParameters(out);
+    }
+
+
+    // Writes what the step was created with, the kind and the parameters without the counters
+    void saveDefinition(SnapshotWriter& out) {
+        out.writeU8(static_cast<uint8_t>(getKind()));
+        saveParameters(out);
+    }
+
+
+    // Virtual functions overriden by the child classes
+    // The step itself only holds what was set when the flow was created, what a run entered is read from ctx
+    virtual void execute(RunContext& ctx) = 0;
+    virtual std::string getStepName() = 0;
+    virtual void displayInfoOnScreen(RunContext& ctx, std::ostream& out) = 0;
+    virtual void addInfoToFile(RunContext& ctx, OutputWriter& out) = 0;
+    virtual void saveParameters(SnapshotWriter& out) = 0; // Only what is set when the flow is created
+
+
+    // Makes room for what the step keeps for every run, steps that keep nothing need no room
+    virtual void reserveState(StateLayout& layout) {}
+
+
+    // What the step produced in the given run, for the run journal, empty for steps that produce nothing
+    virtual std::string getRunResult(RunContext& ctx) {
+        return "";
+    }
+};
+
+
+// Base of the steps that keep something for every run
+// Their State is constructed inside the state block of every run, so any number of runs can share the step
+template <typename State>
+class StatefulStep : public Step {
+private:
+    size_t stateOffset = 0; // Where the state starts inside the state block of a run
+
+
+    static void constructState(char* memory) {
+        new (memory) State();
+    }
+
+
+    static void destroyState(char* memory) {
+        reinterpret_cast<State*>(memory)->~State();
+    }
+
+protected:
+    StatefulStep(StepKind kind) : Step(kind) {}
+
+
+    // Returns the state of the step in the given run
+    State& state(RunContext& ctx) {
+        return *reinterpret_cast<State*>(ctx.stateAt(stateOffset));
+    }
+
+public:
+    void reserveState(StateLayout& layout) override {
+        static_assert(alignof(State) <= alignof(std::max_align_t), "The state block is only aligned for fundamental types");
+        stateOffset = layout.add(sizeof(State), alignof(State), &constructState, &destroyState);
+    }
+};
+
+
+// Storage for the steps of one flow
+// The steps are constructed one after the other inside a few large blocks, so the steps of a flow sit next
+// to each other in memory, and dropping the arena destroys every step and frees all blocks at once
+class StepArena {
+private:
+    static const size_t firstBlockSize = 4096;
+    static const size_t maxBlockSize = 64 << 10; // Blocks double in size up to this
+
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+        size_t used;
+    };
+
+    std::vector<Block> blocks;
+    std::vector<Step*> created; // Every step constructed in the arena, in order
+    size_t bytesUsed = 0;
+    size_t bytesReserved = 0;
+
+
+    // Returns room for an object, in the last block if it still fits
+    void* allocate(size_t size, size_t alignment) {
+        if (!blocks.empty()) {
+            Block& last = blocks.back();
+            size_t offset = (last.used + alignment - 1) & ~(alignment - 1);
+            if (offset + size <= last.size) {
+                last.used = offset + size;
+                bytesUsed += size;
+                return last.data.get() + offset;
+            }
+        }
+
+        // A step larger than a block gets a block of its own size, new char[] is aligned for any step
+        size_t blockSize = blocks.empty() ? firstBlockSize : std::min(maxBlockSize, blocks.back().size * 2);
+        blockSize = std::max(blockSize, size);
+        blocks.push_back(Block{std::unique_ptr<char[]>(new char[blockSize]), blockSize, size});
+        bytesReserved += blockSize;
+        bytesUsed += size;
+        return blocks.back().data.get();
+    }
+
+public:
+    StepArena() {}
+    StepArena(const StepArena&) = delete;
+    StepArena& operator=(const StepArena&) = delete;
+
+
+    // The steps are destroyed in the opposite order they were created in
+    ~StepArena() {
+        for (auto step = created.rbegin(); step != created.rend(); step++) {
+            (*step)->~Step();
+        }
+    }
+
+
+    // Constructs a step inside the arena, the arena owns it from now on
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        static_assert(std::is_base_of_v<Step, T>, "The arena only stores steps");
+        static_assert(alignof(T) <= alignof(std::max_align_t), "The blocks are only aligned for fundamental types");
+
+        void* memory = allocate(sizeof(T), alignof(T));
+        T* step;
+        try {
+            step = new (memory) T(std::forward<Args>(args)...);
+        } catch (...) {
+            // The room stays unused, only the counters are corrected
+            bytesUsed -= sizeof(T);
+            throw;
+        }
+        created.push_back(step);
+        return step;
+    }
+
+
+    // Returns the number of steps in the arena
+    size_t getStepCount() {
+        return created.size();
+    }
+
+
+    // Returns the number of bytes the steps take up
+    size_t getBytesUsed() {
+        return bytesUsed;
+    }
+
+
+    // Returns the number of bytes allocated for the blocks
+    size_t getBytesReserved() {
+        return bytesReserved;
+    }
+
+
+    // Returns the number of blocks
+    size_t getBlockCount() {
+        return blocks.size();
+    }
+};
+
+
+// TitleStep class
+// Title and subtitle are inputted when the object is created
+class TitleStep : public Step {
+private:
+    std::string title = "NO TITLE";
+    std::string subtitle = "NO SUBTITLE";
+
+public:
+    TitleStep(std::string title, std::string subtitle) : Step(StepKind::Title), title(title), subtitle(subtitle) {}
+
+    TitleStep() : Step(StepKind::Title) { // Default constructor
+        std::cout << "---------------------------\n";
+        std::cout << "Creating title step:\n";
+
+        // Get the title
+        std::cout << "Title: ";
+        std::string title;
+        getline(std::cin, title);
+
+        // Get the subtitle
+        std::cout << "Subtitle: ";
+        std::string subtitle;
+        getline(std::cin, subtitle);
+
+        // Assign the input to it's respective field
+        this->title = title;
+        this->subtitle = subtitle;
+    }
+
+
+    // Returns the title
+    std::string getTitle() {
+        return title;
+    }
+
+
+    // Returns the name of the step
+    std::string getStepName() override {
+        return "Title Step";
+    }
+
+
+    // Saves the parameters of the step
+    void saveParameters(SnapshotWriter& out) override {
+        out.writeString(title);
+        out.writeString(subtitle);
+    }
+
+
+    // Setter for the subtitle
+    void setSubtitle(std::string subtitle) {
+        this->subtitle = subtitle;
+    }
+
+
+    // Setter for the title
+    void setTitle(std::string title) {
+        this->title = title;
+    }
+
+
+    // Displays the title and subtitle on the screen
+    void displayInfoOnScreen(RunContext& ctx, std::ostream& out) override {
+        out << "Title Step -> Title: " << title << ", Subtitle: " << subtitle << "\n";
+    }
+
+
+    // Called inside the output step
+    void addInfoToFile(RunContext& ctx, OutputWriter& out) override {
+        std::ostream& file = out.out();
+        file << "---------------------------\n";
+        file << "Title Step:\n";
+        file << "Title: " << title << "\n";
+        file << "Subtitle: " << subtitle << "\n";
+    }
+
+
+    // Main function that gets called when the step is executed
+    void execute(RunContext& ctx) override {
+        std::ostream& out = ctx.out();
+        std::string choice;
+
+        // The user can't continue unless he either completes the step
+        // or skips it
+        while (true) {
+            // Display available options
+            out << "---------------------------\n";
+            out << "Executing Title Step:\n";
+            out << "1. Run this step\n";
+            out << "2. Skip this step\n";
+            out << "Enter your choice: ";
+            ctx.readLine(choice, 0);
+            if (choice == "1") { // Run the step
+                // Ask the user to input the title and subtitle
+                out << "---------------------------\n";
+                out << "Running Title Step:\n";
+                out << "Title: " << title << "\n";
+                out << "Subtitle: " << subtitle << "\n";
+
+                break; // Exit and continue to the next step
+            } else if (choice == "2") { // Skip the step
+                out << "Skipping this Title Step...\n";
+                addSkip(ctx);
+                break; // Exit and continue with the next step
+            } else { // Invalid choice
+                out << "Invalid choice! Please try again.\n";
+                addErrorAtIndex(ctx, 0); // Error on the first screen
+            }
+        }
+    }
+};
+
+
+// TextStep class
+// Both title and copy are inputted when the object is created
+class TextStep : public Step {
+private:
+    // Couln't decide what copy was supposed to be, so it's just an input string
+    std::string title;
+    std::string copy;
+
+public:
+    TextStep(std::string title, std::string copy) : Step(StepKind::Text), title(title), copy(copy) {}
+    TextStep(std::string title) : Step(StepKind::Text), title(title), copy("NO COPY") {}
+    TextStep() : Step(StepKind::Text) {
+        // Ask the user to input the title
+        std::cout << "---------------------------\n";
+        std::cout << "Creaging text step:\n";
+
+        // Get the title
+        std::cout << "Text Title: ";
+        std::string title;
+        getline(std::cin, title);
+        
+        // Get the copy (just some string text)
+        std::cout << "Text Copy: ";
+        std::string copy;
+        getline(std::cin, copy);
+
+        // Assign the input to it's respective field
+        this->title = title;
+        this->copy = copy;
+    }
+
+
+    // Returns the name of the step
+    std::string getStepName() override {
+        return "Text Step";
+    }
+
+
+    // Saves the parameters of the step
+    void saveParameters(SnapshotWriter& out) override {
+        out.writeString(title);
+        out.writeString(copy);
+    }
+
+
+    // Displays the title and copy on the screen
+    void displayInfoOnScreen(RunContext& ctx, std::ostream& out) override {
+        out << "Text Step -> Title: " << title << ", Copy: " << copy << "\n";
+    }
+
+
+    // Called inside the output step
+    void addInfoToFile(RunContext& ctx, OutputWriter& out) override {
+        std::ostream& file = out.out();
+        file << "---------------------------\n";
+        file << "Text Step:\n";
+        file << "Text Title: " << title << "\n";
+        file << "Text Copy: " << copy << "\n";
+    }
+
+
+    // Main function that gets called when the step is executed
+    void execute(RunContext& ctx) override {
+        std::ostream& out = ctx.out();
+        std::string choice;
+        
+        // The user can't continue unless he either completes the step
+        // Or skips it
+        while (true) {
+            // Display available options
+            out << "---------------------------\n";
+            out << "Executing Text Step:\n";
+            out << "1. Run this step\n";
+            out << "2. Skip this step\n";
+
+            out << "Enter your choice: ";
+            ctx.readLine(choice, 0);
+
+            if (choice == "1") { // Run the step
+                // Ask the user to input the title and copy (just some text)
+                out << "---------------------------\n";
+                out << "Running Text Step:\n";
+                out << "Text Title: " << title << "\n";
+                out << "Text Copy: " << copy << "\n";
+
+                break; // Exit and continue with the next step
+            } else if (choice == "2") { // Skip the step
+                out << "Skipping this Text Step...\n";
+                addSkip(ctx);
+                break; // Exit and continue with the next step
+            } else { // Invalid choice
+                out << "Invalid choice! Please try again.\n";
+                addErrorAtIndex(ctx, 0); // Error on the first screen
+            }
+        }
+    }
+};
+
+
+// What a TextInput step keeps for every run
+struct TextInputState {
+    std::string text = "NOTEXT";
+};
+
+
+// TextInput class
+// Description is inputted when the object is created, text is inputted when the step is executed
+class TextInput : public StatefulStep<TextInputState> {
+private:
+    std::string description;
+
+public:
+    TextInput(std::string description) : StatefulStep(StepKind::TextInput), description(description) {}
+    TextInput() : StatefulStep(StepKind::TextInput) {
+        std::cout << "---------------------------\n";
+        std::cout << "Creating text input step:\n";
+
+        // Get the description
+        std::cout << "Text Input Description: ";
+        std::string description;
+        getline(std::cin, description);
+
+        // Assign the input to it's respective field
+        this->description = description;
+    }
+
+
+    // Returns the name of the step
+    std::string getStepName() override {
+        return "Text Input Step";
+    }
+
+
+    // Saves the parameters of the step
+    void saveParameters(SnapshotWriter& out) override {
+        out.writeString(description);
+    }
+
+
+    // Returns the text entered in the given run
+    std::string getRunResult(RunContext& ctx) override {
+        return state(ctx).text;
+    }
+
+
+    // Returns the text description and text on the screen
+    void displayInfoOnScreen(RunContext& ctx, std::ostream& out) override {
+        out << "Text Input Step -> Description: " << description << ", Text: " << state(ctx).text << "\n";
+    }
+
+
+    // Called inside the output step
+    void addInfoToFile(RunContext& ctx, OutputWriter& out) override {
+        std::ostream& file = out.out();
+        file << "---------------------------\n";
+        file << "Text Input Step:\n";
+        file << "Text Description: " << description << "\n";
+        file << "Text Input: " << state(ctx).text << "\n";
+    }
+
+
+    // Main function that gets called when the step is executed
+    void execute(RunContext& ctx) override {
+        std::ostream& out = ctx.out();
+        TextInputState& state = this->state(ctx);
+
+        while (true) {
+            // Display available options
+            out << "---------------------------\n";
+            out << "Executing Text Input Step:\n";
+            out << "1. Run this step\n";
+            out << "2. Skip this step\n";
+            out << "Enter your choice: ";
+            std::string choice;
+            ctx.readLine(choice, 0);
+
+            if (choice == "1") { // Run the step
+                // Ask the user to input the description and text
+                out << "---------------------------\n";
+                out << "Running Text Input Step:\n";
+                out << "Text Input Description: " << description << "\n";
+                out << "Enter your Text: ";
+                std::string text;
+                ctx.readLine(text, 1);
+
+                // Asign the new input to the state of the run
+                state.text = text;
+
+                break; // Exit and continue with the next step
+            } else if (choice == "2") { // Skip the step
+                out << "Skipping this Text Input Step...\n";
+                addSkip(ctx);
+                break; // Exit and continue with the next step
+            } else { // Invalid choice
+                out << "Invalid choice! Please try again.\n";
+                addErrorAtIndex(ctx, 0); // Error on the first screen
+            }
+        }
+    }
+};
+
+
+// What a NumberInput step keeps for every run
+template <typename T>
+struct NumberInputState {
+    T number = T();
+};
+
+
+template <typename T>
+// NumberInput class
+class NumberInput : public StatefulStep<NumberInputState<T>> {
+private:
+    using StatefulStep<NumberInputState<T>>::state;
+    using Step::addErrorAtIndex;
+    using Step::addSkip;
+
+    std::string description;
+
+public:
+    NumberInput(std::string description) : StatefulStep<NumberInputState<T>>(NumberTraits<T>::inputKind), description(description) {}
+    NumberInput() : StatefulStep<NumberInputState<T>>(NumberTraits<T>::inputKind) {
+        std::cout << "---------------------------\n";
+        std::cout << "Creating Number Input Step:\n";
+
+        // Get the description
+        std::cout << "Number Description: ";
+        std::string description;
+        getline(std::cin, description);
+
+        // Assign the input to it's respective field
+        this->description = description;
+    }
+
+
+    // Returns the name of the step, with its number type unless it is a float
+    std::string getStepName() override {
+        std::string type = NumberTraits<T>::name;
+        return type.empty() ? "Number Input Step" : "Number Input Step (" + type + ")";
+    }
+
+
+    // Saves the parameters of the step
+    void saveParameters(SnapshotWriter& out) override {
+        out.writeString(description);
+    }
+
+
+    // Returns the number entered in the given run
+    T getNumber(RunContext& ctx) {
+        return state(ctx).number;
+    }
+
+
+    // Returns what the given run produced
+    std::string getRunResult(RunContext& ctx) override {
+        return formatNumber(state(ctx).number);
+    }
+
+
+    // Returns the description
+    std::string getDescription() {
+        return description;
+    }
+
+
+    // Displays the description and number on the screen
+    void displayInfoOnScreen(RunContext& ctx, std::ostream& out) override {
+        out << "Number Input Step -> Description: " << description << ", Number: " << state(ctx).number << "\n";
+    }
+
+
+    // Called inside the output step
+    void addInfoToFile(RunContext& ctx, OutputWriter& out) override {
+        std::ostream& file = out.out();
+        file << "---------------------------\n";
+        file << "NumberInput Step:\n";
+        file << "Description: " << description << "\n";
+        file << "Number: " << state(ctx).number << "\n";
+    }
+
+
+    // Main function that gets called when the step is executed
+    void execute(RunContext& ctx) override {
+        std::ostream& out = ctx.out();
+        NumberInputState<T>& state = this->state(ctx);
+
+        std::string choice;
+
+        // The user can't continue unless he either completes the step
+        // Or skips it
+        while (true) {
+            // Display available options
+            out << "---------------------------\n";
+            out << "Executing Number Input Step:\n";
+            out << "1. Run this step\n";
+            out << "2. Skip this step\n";
+            out << "Enter your choice: ";
+            ctx.readLine(choice, 0);
+            
+            if (choice == "1") { // Run the step
+                // Ask the user to input the description and number
+                out << "---------------------------\n";
+                out << "Running Number Input Step:\n";
+                out << "Number Description: " << description << "\n";
+
+                bool validNumber = false;
+
+                while (!validNumber) { // Keep asking for a number until the user enters a valid one
+                    out << "Enter your Number: ";
+                    std::string number;
+                    ctx.readLine(number, 1); // Get the number as a string
+
+                    ParseError error = parseNumber(number, state.number);
+                    if (error == ParseError::None) {
+                        validNumber = true;
+                    } else if (error == ParseError::OutOfRange) {
+                        out << "Number out of range! Please try again.\n";
+                        addErrorAtIndex(ctx, 1); // Error on the second screen
+                    } else {
+                        out << "Invalid number! Please try again.\n";
+                        addErrorAtIndex(ctx, 1); // Error on the second screen
+                    }
+                }
+
+                break;
+            } else if (choice == "2") { // Skip the step
+                out << "Skipping this Number Input Step...\n";
+                addSkip(ctx);
+                break; // Exit and continue with the next step
+            } else { // Invalid choice
+                out << "Invalid choice! Please try again.\n";
+                addErrorAtIndex(ctx, 0); // Error on the first screen
+            }
+        }
+    }
+};
+
+
+// What a TextFileStep keeps for every run
+struct TextFileState {
+    std::string name = "NOFILE"; // Default value
+};
+
+
+// TextFileStep class
+class TextFileStep : public StatefulStep<TextFileState> {
+private:
+    std::string description; // The file itself is chosen when the step runs and only opened while it is read
+
+public:
+    TextFileStep() : StatefulStep(StepKind::TextFile) {
+        std::cout << "---------------------------\n";
+        std::cout << "Creating Text File Step:\n";
+
+        // Get the description
+        std::cout << "Text File Description: ";
+        std::string description;
+        getline(std::cin, description);
+
+        // Assign the input to it's respective field
+        this->description = description;
+    }
+
+
+    // Used when loading the flow from a snapshot, the file is chosen when the step runs
+    TextFileStep(std::string description) : StatefulStep(StepKind::TextFile), description(description) {}
+
+
+    // Returns the name of the step
+    std::string getStepName() override {
+        return "File Input Step";
+    }
+
+
+    // Saves the parameters of the step
+    void saveParameters(SnapshotWriter& out) override {
+        out.writeString(description);
+    }
+
+
+    // Returns the name of the file chosen in the given run
+    std::string getName(RunContext& ctx) {
+        return state(ctx).name;
+    }
+
+
+    // Displays the name of the stored file
+    void displayInfoOnScreen(RunContext& ctx, std::ostream& out) override {
+        out << "TextFile Step -> Description: " << description << ", Name: " << state(ctx).name << "\n";
+    }
+
+
+    // Called inside the output step, adds the info to the file
+    void addInfoToFile(RunContext& ctx, OutputWriter& out) override {
+        std::ostream& file = out.out();
+        file << "---------------------------\n";
+        file << "TextFile Step:\n";
+        file << "Text File Description: " << this->description << "\n";
+        file << "File Name: " << state(ctx).name << "\n";
+        file << "Contents:\n";
+
+        addContentsFromFirstFileToSecond(state(ctx).name, out);
+    }
+
+
+    // Main function that gets called when the step is executed
+    void execute(RunContext& ctx) override {
+        std::ostream& out = ctx.out();
+        std::string choice = "0";
+
+        while (choice != "1" || choice != "2") {
+            // Display available options
+            out << "---------------------------\n";
+            out << "Executing Text File Step:\n";
+            out << "1. Run this step\n";
+            out << "2. Skip this step\n";
+
+            // Get the user's choice
+            out << "Enter your choice: ";
+            ctx.readLine(choice, 0);
+
+            std::string filename;
+
+            if (choice == "1") { // Run the step
+                while (true) {
+                    out << "---------------------------\n";
+                    out << "Running Text File Step:\n";
+                    out << "File description: " << description << "\n";
+
+                    out << "Enter File Name: ";
+                    std::string filename;
+                    ctx.readLine(filename, 1);
+
+                    // Mapping the file checks it exists, the display and output steps then find it in the file cache
+                    try {
+                        FileCache::shared().acquire(filename + ".txt");
+                    } catch (const std::exception& e) {
+                        out << "File not found! It will not be added.\n";
+                        addErrorAtIndex(ctx, 1); // Error on the second screen
+                        return;
+                    }
+                    state(ctx).name = filename + ".txt";
+                    break;
+                }
+
+                return; // Exit and continue with the next step
+            } else if (choice == "2") { // Skip the step
+                out << "Skipping this step...\n";
+                addSkip(ctx);
+                break; // Exit and continue with the next step
+            } else { // Invalid choice
+                out << "Invalid choice! Please try again.\n";
+                addErrorAtIndex(ctx, 0); // Error on the first screen
+            }
+        }
+    }
+};
+
+
+// What a CsvFileStep keeps for every run
+struct CsvFileState {
+    std::string name = "NOFILE"; // Default value
+    std::shared_ptr<CsvTable> table; // The parsed file, null until the step runs
+};
+
+
+// CsvFileStep class
+class CsvFileStep : public StatefulStep<CsvFileState> {
+private:
+    std::string description; // The file itself is chosen when the step runs and only opened while it is read
+
+public:
+    // Default constructor is called when creating the flow
+    CsvFileStep() : StatefulStep(StepKind::CsvFile) {
+        std::cout << "---------------------------\n";
+        std::cout << "Creating Csv File Step:\n";
+
+        // Get the description
+        std::cout << "Csv File Description: ";
+        std::string description;
+        getline(std::cin, description);
+
+        // Assign the input to it's respective field
+        this->description = description;
+    }
+
+
+    // Used when loading the flow from a snapshot, the file is chosen when the step runs
+    CsvFileStep(std::string description) : StatefulStep(StepKind::CsvFile), description(description) {}
+
+
+    // Returns the name of the step
+    std::string getStepName() override {
+        return "Csv File Step";
+    }
+
+
+    // Saves the parameters of the step
+    void saveParameters(SnapshotWriter& out) override {
+        out.writeString(description);
+    }
+
+
+    // Returns the name of the file chosen in the given run
+    std::string getName(RunContext& ctx) {
+        return state(ctx).name;
+    }
+
+
+    // Returns the file parsed in the given run, null if the step was skipped or didn't run
+    std::shared_ptr<CsvTable> getTable(RunContext& ctx) {
+        return state(ctx).table;
+    }
+
+
+    // Displays the name of the stored file
+    void displayInfoOnScreen(RunContext& ctx, std::ostream& out) override {
+        out << "CsvFile Step -> Description: " << description << ", Name: " << state(ctx).name << "\n";
+    }
+
+
+    // Called inside the output step, adds the info to the file
+    void addInfoToFile(RunContext& ctx, OutputWriter& out) override {
+        std::ostream& file = out.out();
+        file << "---------------------------\n";
+        file << "CsvFile Step:\n";
+        file << "Description: " << description << "\n";
+        file << "Name: " << state(ctx).name << "\n";
+        file << "Contents:\n";
+        addContentsFromFirstFileToSecond(state(ctx).name, out); // Add the contents of the csv file to the output file
+    }
+
+
+    // Main function that gets called when the step is executed
+    void execute(RunContext& ctx) override {
+        std::ostream& out = ctx.out();
+        CsvFileState& state = this->state(ctx);
+        std::string choice = "0";
+        while (choice != "1" || choice != "2") {
+            // Display available options
+            out << "---------------------------\n";
+            out << "Running CsvFile Step:\n";
+            out << "1. Run this step\n";
+            out << "2. Skip this step\n";
+
+            // Get the user's choice
+            out << "Enter your choice: ";
+            ctx.readLine(choice, 0);
+
+            if (choice == "1") { // Run the step
+                while (true) {
+                    out << "---------------------------\n";
+                    out << "Running CsvFile Step:\n";
+                    out << "File description: " << description << "\n";
+
+                    out << "Enter File Name: ";
+                    std::string filename;
+                    ctx.readLine(filename, 1);
+
+                    std::shared_ptr<MappedFile> file;
+                    try {
+                        file = FileCache::shared().acquire(filename + ".csv");
+                    } catch (const std::exception& e) {
+                        out << "File not found! It will not be added.\n";
+                        addErrorAtIndex(ctx, 1); // Error on the second screen
+                        return;
+                    }
+
+                    // Parse the file, a malformed file is not added
+                    try {
+                        state.table = std::make_shared<CsvTable>(file);
+                    } catch (const std::exception& e) {
+                        out << "Error: " << e.what() << ". It will not be added.\n";
+                        addErrorAtIndex(ctx, 1); // Error on the second screen
+                        return;
+                    }
+                    state.name = filename + ".csv";
+
+                    // Show what was found in the file
+                    CsvTable* table = state.table.get();
+                    out << "Loaded " << table->getRowCount() << " rows and " << table->getColumnCount() << " columns";
+                    if (table->hasHeader()) {
+                        out << " (the first row is a header)";
+                    }
+                    out << "\n";
+                    for (size_t i = 0; i < table->getColumnCount(); i++) {
+                        out << "Column " << i + 1 << ": " << csvTypeName(table->getColumnType(i)) << "\n";
+                    }
+                    break;
+                }
+
+                return; // Exit and continue with the next step
+            } else if (choice == "2") {
+                out << "Skipping this step...\n";
+                addSkip(ctx);
+                break; // Exit and continue with the next step
+            } else { // Invalid choice
+                out << "Invalid choice! Please try again.\n";
+                addErrorAtIndex(ctx, 0); // Error on the first screen
+            }
+        }
+    }
+};
+
+
+// What a ColumnAggregateStep keeps for every run
+struct ColumnAggregateState {
+    std::string fileName = "NOFILE"; // The csv file the column was taken from
+    std::string columnName;
+    std::string operation;
+    double result = 0;
+};
+
+
+// ColumnAggregateStep class
+class ColumnAggregateStep : public StatefulStep<ColumnAggregateState> {
+private:
+    std::string description;
+
+
+    // Reads the numbers of a column straight from the mapped file and reduces them in blocks
+    // Fields that are not numbers are left out, like the header
+    ColumnStats reduceColumn(CsvTable& table, size_t column) {
+        ColumnStats stats;
+        const size_t blockSize = 4096;
+        std::unique_ptr<double[]> block(new double[blockSize]);
+        size_t filled = 0;
+
+        for (size_t row = table.hasHeader() ? 1 : 0; row < table.getRowCount(); row++) {
+            const char* data;
+            size_t size;
+            double value;
+            if (!table.findField(row, column, data, size) || parseNumber(std::string_view(data, size), value) != ParseError::None) {
+                continue;
+            }
+
+            block[filled++] = value;
+            if (filled == blockSize) {
+                stats.add(block.get(), filled);
+                filled = 0;
+            }
+        }
+        stats.add(block.get(), filled);
+        return stats;
+    }
+
+public:
+    // Default constructor is called when creating the flow
+    ColumnAggregateStep() : StatefulStep(StepKind::ColumnAggregate) {
+        std::cout << "---------------------------\n";
+        std::cout << "Creating Column Aggregate Step:\n";
+
+        // Get the description
+        std::cout << "Column Aggregate Description: ";
+        getline(std::cin, description);
+    }
+
+
+    // Used when loading the flow from a snapshot, the column is chosen when the step runs
+    ColumnAggregateStep(std::string description) : StatefulStep(StepKind::ColumnAggregate), description(description) {}
+
+
+    // Returns the name of the step
+    std::string getStepName() override {
+        return "Column Aggregate Step";
+    }
+
+
+    // Saves the parameters of the step
+    void saveParameters(SnapshotWriter& out) override {
+        out.writeString(description);
+    }
+
+
+    // Returns the description of the step
+    std::string getDescription() {
+        return description;
+    }
+
+
+    // Returns the result of the aggregation in the given run
+    double getResult(RunContext& ctx) {
+        return state(ctx).result;
+    }
+
+
+    // Returns what the given run produced
+    std::string getRunResult(RunContext& ctx) override {
+        return formatNumber(state(ctx).result);
+    }
+
+
+    // Displays the column and result on the screen
+    void displayInfoOnScreen(RunContext& ctx, std::ostream& out) override {
+        ColumnAggregateState& state = this->state(ctx);
+        out << "Column Aggregate Step -> Description: " << description << ", File: " << state.fileName << ", Column: " << state.columnName << ", Operation: " << state.operation << ", Result: " << state.result << "\n";
+    }
+
+
+    // Called inside the output step
+    void addInfoToFile(RunContext& ctx, OutputWriter& out) override {
+        ColumnAggregateState& state = this->state(ctx);
+        std::ostream& file = out.out();
+        file << "---------------------------\n";
+        file << "Column Aggregate Step:\n";
+        file << "Description: " << description << "\n";
+        file << "File: " << state.fileName << "\n";
+        file << "Column: " << state.columnName << "\n";
+        file << "Operation: " << state.operation << "\n";
+        file << "Result: " << state.result << "\n";
+    }
+
+
+    // Main function that gets called when the step is executed
+    void execute(RunContext& ctx) override {
+        std::ostream& out = ctx.out();
+        ColumnAggregateState& state = this->state(ctx);
+        while (true) {
+            // Display available options
+            out << "---------------------------\n";
+            out << "Running Column Aggregate Step:\n";
+            out << "1. Run this step\n";
+            out << "2. Skip this step\n";
+            out << "Enter your choice: ";
+            std::string choice;
+            ctx.readLine(choice, 0);
+
+            if (choice == "1") { // Run the step
+                // Only the csv files that were loaded can be aggregated
+                std::vector<CsvFileStep*> files;
+                for (auto file : ctx.csvFileSteps) {
+                    if (file->getTable(ctx) != nullptr) {
+                        files.push_back(file);
+                    }
+                }
+                if (files.empty()) {
+                    out << "There are no loaded Csv File Steps! Please run one first.\n";
+                    addErrorAtIndex(ctx, 0); // Error on the first screen
+                    return;
+                }
+
+                // Keep asking for a file and a column until the column has numbers in it
+                ColumnStats stats;
+                while (true) {
+                    out << "---------------------------\n";
+                    out << "Running Column Aggregate Step:\n";
+                    out << "Choose the file:\n";
+                    for (size_t i = 0; i < files.size(); i++) {
+                        out << i + 1 << ". " << files[i]->getName(ctx) << "\n";
+                    }
+                    out << "Enter your choice: ";
+                    std::string fileChoice;
+                    ctx.readLine(fileChoice, 1);
+                    size_t fileIndex;
+                    if (parseChoice(fileChoice, files.size(), fileIndex) != ParseError::None) {
+                        out << "Invalid choice! Please try again.\n";
+                        addErrorAtIndex(ctx, 1); // Error on the second screen
+                        continue;
+                    }
+                    CsvFileStep* file = files[fileIndex];
+                    std::shared_ptr<CsvTable> table = file->getTable(ctx);
+
+                    // Display the columns, with their names when the file has a header
+                    out << "Choose the column:\n";
+                    for (size_t i = 0; i < table->getColumnCount(); i++) {
+                        out << i + 1 << ". " << (table->hasHeader() ? table->getField(0, i) : "Column " + std::to_string(i + 1));
+                        out << " (" << csvTypeName(table->getColumnType(i)) << ")\n";
+                    }
+                    out << "Enter your choice: ";
+                    std::string columnChoice;
+                    ctx.readLine(columnChoice, 1);
+                    size_t column;
+                    if (parseChoice(columnChoice, table->getColumnCount(), column) != ParseError::None) {
+                        out << "Invalid choice! Please try again.\n";
+                        addErrorAtIndex(ctx, 1); // Error on the second screen
+                        continue;
+                    }
+
+                    // A single pass gives every aggregate, the operation only picks one of them
+                    stats = reduceColumn(*table, column);
+                    if (stats.getCount() == 0) {
+                        out << "The column has no numbers! Please choose another one.\n";
+                        addErrorAtIndex(ctx, 1); // Error on the second screen
+                        continue;
+                    }
+                    state.fileName = file->getName(ctx);
+                    state.columnName = table->hasHeader() ? table->getField(0, column) : "Column " + std::to_string(column + 1);
+                    break;
+                }
+
+                // Ask the user to choose an operation, can't be skipped
+                while (true) {
+                    out << "---------------------------\n";
+                    out << "Running Column Aggregate Step:\n";
+                    out << "Choose the operation:\n";
+                    out << "1. Sum\n";
+                    out << "2. Min\n";
+                    out << "3. Max\n";
+                    out << "4. Mean\n";
+                    out << "5. Count\n";
+                    out << "Enter your choice: ";
+                    std::string operationChoice;
+                    ctx.readLine(operationChoice, 2);
+
+                    if (operationChoice == "1") {
+                        state.operation = "Sum";
+                        state.result = stats.getSum();
+                    } else if (operationChoice == "2") {
+                        state.operation = "Min";
+                        state.result = stats.getMin();
+                    } else if (operationChoice == "3") {
+                        state.operation = "Max";
+                        state.result = stats.getMax();
+                    } else if (operationChoice == "4") {
+                        state.operation = "Mean";
+                        state.result = stats.getMean();
+                    } else if (operationChoice == "5") {
+                        state.operation = "Count";
+                        state.result = stats.getCount();
+                    } else { // Invalid choice
+                        out << "Invalid choice! Please try again.\n";
+                        addErrorAtIndex(ctx, 2); // Error on the third screen
+                        continue;
+                    }
+
+                    out << state.operation << " of " << state.columnName << " in " << state.fileName << " = " << state.result << "\n";
+                    return; // Exit and continue with the next step
+                }
+            } else if (choice == "2") { // Skip the step
+                out << "Skipping this step...\n";
+                addSkip(ctx);
+                return; // Exit and continue with the next step
+            } else { // Invalid choice
+                out << "Invalid choice! Please try again.\n";
+                addErrorAtIndex(ctx, 0); // Error on the first screen
+            }
+        }
+    }
+};
+
+
+// How many steps of each kind an expression can refer to
+struct OperandCounts {
+    size_t numberInputs = 0;
+    size_t calculusSteps = 0;
+    size_t aggregateSteps = 0;
+};
+
+
+// An arithmetic expression parsed once into a postfix program
+// Operands are n1, n2... for the number inputs, c1, c2... for the calculus results and a1, a2... for the
+// column aggregates of the flow, plus numbers, + - * / with parentheses and min(...), max(...)
+// The numbers are kept as written, each calculus step reads them with its own number type
+class Expression {
+public:
+    enum class OpCode : uint8_t {
+        Constant,
+        NumberInput,
+        Calculus,
+        Aggregate,
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Negate,
+        Min,
+        Max
+    };
+
+    struct Instruction {
+        OpCode op;
+        uint32_t index; // Which step an operand is taken from, or which constant
+    };
+
+    static const int maxDepth = 32; // Values the program can keep on the stack at the same time
+    static const int maxNesting = maxDepth; // Parentheses, negations and function calls a factor can be inside
+
+private:
+    std::string text;
+    std::vector<Instruction> code;
+    std::vector<std::string> constants; // The numbers of the expression, as written
+    OperandCounts used; // One past the highest step of each kind the program refers to
+    int depth = 0; // Values on the stack at this point of the program, only used while compiling
+    size_t position = 0; // Only used while compiling
+
+
+    [[noreturn]] void fail(const std::string& message) {
+        throw std::runtime_error(message + " at position " + std::to_string(position + 1));
+    }
+
+
+    void skipSpaces() {
+        while (position < text.size() && text[position] == ' ') {
+            position++;
+        }
+    }
+
+
+    bool accept(char c) {
+        skipSpaces();
+        if (position < text.size() && text[position] == c) {
+            position++;
+            return true;
+        }
+        return false;
+    }
+
+
+    void push(Instruction instruction) {
+        code.push_back(instruction);
+        if (++depth > maxDepth) {
+            fail("The expression is nested too deeply");
+        }
+    }
+
+
+    // Adds an operator, all but the negation take two values from the stack and leave one
+    void emit(OpCode op) {
+        if (op != OpCode::Negate) {
+            depth--;
+        }
+        code.push_back({op, 0});
+    }
+
+
+    // expression := term (('+' | '-') term)*
+    // nesting counts the parentheses, negations and function calls around it, every one of them is a recursion
+    void parseExpression(int nesting) {
+        parseTerm(nesting);
+        while (true) {
+            if (accept('+')) {
+                parseTerm(nesting);
+                emit(OpCode::Add);
+            } else if (accept('-')) {
+                parseTerm(nesting);
+                emit(OpCode::Subtract);
+            } else {
+                return;
+            }
+        }
+    }
+
+
+    // term := factor (('*' | '/') factor)*
+    void parseTerm(int nesting) {
+        parseFactor(nesting);
+        while (true) {
+            if (accept('*')) {
+                parseFactor(nesting);
+                emit(OpCode::Multiply);
+            } else if (accept('/')) {
+                parseFactor(nesting);
+                emit(OpCode::Divide);
+            } else {
+                return;
+            }
+        }
+    }
+
+
+    // factor := '-' factor | number | operand | function '(' expression (',' expression)* ')' | '(' expression ')'
+    // The nesting is limited, so a long run of '(' or '-' fails instead of running out of stack
+    void parseFactor(int nesting) {
+        if (nesting > maxNesting) {
+            fail("The expression is nested too deeply");
+        }
+        if (accept('-')) {
+            parseFactor(nesting + 1);
+            emit(OpCode::Negate);
+            return;
+        }
+        if (accept('(')) {
+            parseExpression(nesting + 1);
+            if (!accept(')')) {
+                fail("Expected ')'");
+            }
+            return;
+        }
+
+        skipSpaces();
+        if (position >= text.size()) {
+            fail("Unexpected end of the expression");
+        }
+
+        char c = text[position];
+        if ((c >= '0' && c <= '9') || c == '.') {
+            size_t start = position;
+            while (position < text.size() && ((text[position] >= '0' && text[position] <= '9') || text[position] == '.')) {
+                position++;
+            }
+            constants.push_back(text.substr(start, position - start));
+            push({OpCode::Constant, static_cast<uint32_t>(constants.size() - 1)});
+            return;
+        }
+
+        // A name, either an operand or a function
+        size_t start = position;
+        while (position < text.size() && isalnum(static_cast<unsigned char>(text[position]))) {
+            position++;
+        }
+        std::string name = text.substr(start, position - start);
+        if (name == "min" || name == "max") {
+            OpCode op = name == "min" ? OpCode::Min : OpCode::Max;
+            if (!accept('(')) {
+                fail("Expected '(' after " + name);
+            }
+            parseExpression(nesting + 1);
+            while (accept(',')) {
+                parseExpression(nesting + 1);
+                emit(op);
+            }
+            if (!accept(')')) {
+                fail("Expected ')'");
+            }
+            return;
+        }
+
+        uint32_t number = 0;
+        if (name.size() < 2 || std::from_chars(name.data() + 1, name.data() + name.size(), number).ptr != name.data() + name.size() || number == 0) {
+            position = start;
+            fail("Unknown name '" + name + "'");
+        }
+        if (name[0] == 'n') {
+            push({OpCode::NumberInput, number - 1});
+            used.numberInputs = std::max<size_t>(used.numberInputs, number);
+        } else if (name[0] == 'c') {
+            push({OpCode::Calculus, number - 1});
+            used.calculusSteps = std::max<size_t>(used.calculusSteps, number);
+        } else if (name[0] == 'a') {
+            push({OpCode::Aggregate, number - 1});
+            used.aggregateSteps = std::max<size_t>(used.aggregateSteps, number);
+        } else {
+            position = start;
+            fail("Unknown name '" + name + "'");
+        }
+    }
+
+public:
+    Expression() {}
+
+
+    // Compiles the text, throws if it isn't a valid expression
+    Expression(const std::string& source) : text(source) {
+        parseExpression(0);
+        skipSpaces();
+        if (position != text.size()) {
+            fail("Unexpected '" + std::string(1, text[position]) + "'");
+        }
+    }
+
+
+    // Returns true if every step the expression refers to is among the available ones
+    bool fits(const OperandCounts& available) const {
+        return used.numberInputs <= available.numberInputs && used.calculusSteps <= available.calculusSteps
+            && used.aggregateSteps <= available.aggregateSteps;
+    }
+
+
+    bool empty() const {
+        return code.empty();
+    }
+
+
+    const std::string& getText() const {
+        return text;
+    }
+
+
+    const std::vector<Instruction>& getCode() const {
+        return code;
+    }
+
+
+    const std::string& getConstant(uint32_t index) const {
+        return constants[index];
+    }
+};
+
+
+// Why a calculation has no result
+enum class CalcError : uint8_t {
+    None,
+    DivisionByZero,
+    Overflow
+};
+
+
+// Applies one of the operators that take two values, with the arithmetic of the number type
+template <typename T>
+CalcError calculate(Expression::OpCode op, T left, T right, T& result) {
+    bool fits = true;
+    switch (op) {
+    case Expression::OpCode::Add:
+        fits = NumberTraits<T>::add(left, right, result);
+        break;
+    case Expression::OpCode::Subtract:
+        fits = NumberTraits<T>::subtract(left, right, result);
+        break;
+    case Expression::OpCode::Multiply:
+        fits = NumberTraits<T>::multiply(left, right, result);
+        break;
+    case Expression::OpCode::Divide:
+        if (right == T()) {
+            return CalcError::DivisionByZero;
+        }
+        fits = NumberTraits<T>::divide(left, right, result);
+        break;
+    case Expression::OpCode::Min:
+        result = right < left ? right : left;
+        break;
+    default:
+        result = left < right ? right : left;
+        break;
+    }
+    return fits ? CalcError::None : CalcError::Overflow;
+}
+
+
+// Returns the message shown for a calculation error
+const char* calcErrorMessage(CalcError error) {
+    return error == CalcError::DivisionByZero ? "Division by zero is not allowed." : "The result is too large for this number type.";
+}
+
+
+// What a CalculusStep keeps for every run
+template <typename T>
+struct CalculusState {
+    T number1 = T();
+    T number2 = T();
+    T result = T();
+    std::string operation;
+};
+
+
+// CalculusStep class
+// T is the number type the step computes with, it only uses number inputs and calculus steps of the same type
+template <typename T>
+class CalculusStep : public StatefulStep<CalculusState<T>> {
+private:
+    using StatefulStep<CalculusState<T>>::state;
+    using Step::addErrorAtIndex;
+    using Step::addSkip;
+
+    // One instruction of the expression, with its constant already read as a T
+    struct Operation {
+        Expression::OpCode op;
+        uint32_t index;
+        T value;
+    };
+
+    Expression expression; // Empty if the operands are chosen when the step runs
+    std::vector<Operation> program; // The expression over T, the constants folded
+
+
+    // Turns the expression into a program over T, reading its numbers as T and folding the operators
+    // that only use numbers, throws if a number isn't valid for the type
+    void translate() {
+        program.clear();
+        for (const Expression::Instruction& instruction : expression.getCode()) {
+            size_t size = program.size();
+            if (instruction.op == Expression::OpCode::Constant) {
+                T value;
+                const std::string& constant = expression.getConstant(instruction.index);
+                if (parseNumber(constant, value) != ParseError::None) {
+                    throw std::runtime_error("'" + constant + "' is not a valid " + typeName() + " number");
+                }
+                program.push_back({instruction.op, 0, value});
+                continue;
+            }
+
+            // The last instruction of an operand is a constant only if the whole operand is one
+            T folded;
+            if (instruction.op == Expression::OpCode::Negate && program[size - 1].op == Expression::OpCode::Constant
+                && calculate(Expression::OpCode::Subtract, T(), program[size - 1].value, folded) == CalcError::None) {
+                program[size - 1].value = folded;
+                continue;
+            }
+            if (instruction.op >= Expression::OpCode::Add && instruction.op != Expression::OpCode::Negate
+                && program[size - 2].op == Expression::OpCode::Constant && program[size - 1].op == Expression::OpCode::Constant
+                && calculate(instruction.op, program[size - 2].value, program[size - 1].value, folded) == CalcError::None) {
+                program[size - 2].value = folded;
+                program.pop_back();
+                continue;
+            }
+            program.push_back({instruction.op, instruction.index, T()});
+        }
+    }
+
+
+    // Runs the program over the results reached so far
+    CalcError evaluate(RunContext& ctx) {
+        NumberSteps<T>& numbers = ctx.numbers<T>();
+        T stack[Expression::maxDepth];
+        int top = -1;
+        for (const Operation& operation : program) {
+            switch (operation.op) {
+            case Expression::OpCode::Constant:
+                stack[++top] = operation.value;
+                break;
+            case Expression::OpCode::NumberInput:
+                stack[++top] = numbers.inputs[operation.index]->getNumber(ctx);
+                break;
+            case Expression::OpCode::Calculus:
+                stack[++top] = numbers.calculusSteps[operation.index]->getResult(ctx);
+                break;
+            case Expression::OpCode::Aggregate:
+                if (!NumberTraits<T>::fromDouble(ctx.aggregateSteps[operation.index]->getResult(ctx), stack[++top])) {
+                    return CalcError::Overflow;
+                }
+                break;
+            case Expression::OpCode::Negate:
+                if (!NumberTraits<T>::subtract(T(), stack[top], stack[top])) {
+                    return CalcError::Overflow;
+                }
+                break;
+            default: {
+                top--;
+                CalcError error = calculate(operation.op, stack[top], stack[top + 1], stack[top]);
+                if (error != CalcError::None) {
+                    return error;
+                }
+                break;
+            }
+            }
+        }
+        state(ctx).result = stack[0];
+        return CalcError::None;
+    }
+
+
+    // Returns the number type, as shown to the user
+    static std::string typeName() {
+        std::string type = NumberTraits<T>::name;
+        return type.empty() ? "float" : type;
+    }
+
+
+    // Keeps asking for one of the operands until the user enters a valid one
+    // The number input steps are listed first, followed by the results of the column aggregate steps
+    T chooseOperand(RunContext& ctx, const std::string& which) {
+        std::ostream& out = ctx.out();
+        NumberSteps<T>& numbers = ctx.numbers<T>();
+        while (true) {
+            out << "---------------------------\n";
+            out << "Running Calculus Step:\n";
+            out << "Choose the " << which << " operand:\n";
+
+            // Display a list of available operands and let the user choose
+            for (int i = 0; i < numbers.inputs.size(); i++) {
+                out << i + 1 << ". " << numbers.inputs[i]->getNumber(ctx) << " (" << numbers.inputs[i]->getDescription() << ")" << "\n";
+            }
+            for (int i = 0; i < ctx.aggregateSteps.size(); i++) {
+                out << i + 1 + numbers.inputs.size() << ". " << ctx.aggregateSteps[i]->getResult(ctx) << " (" << ctx.aggregateSteps[i]->getDescription() << ")" << "\n";
+            }
+
+            // Get the user's choice
+            out << "Enter your choice: ";
+            std::string choice;
+            ctx.readLine(choice, 1);
+
+            // Verify that the user entered a valid number and within acceptable range
+            size_t index;
+            ParseError error = parseChoice(choice, numbers.inputs.size() + ctx.aggregateSteps.size(), index);
+            if (error == ParseError::OutOfRange) {
+                out << "Invalid choice! Please try again.\n";
+                addErrorAtIndex(ctx, 1); // Error on the second screen
+                continue;
+            } else if (error != ParseError::None) {
+                out << "Invalid choice! Please enter a number.\n";
+                addErrorAtIndex(ctx, 1); // Error on the second screen
+                continue;
+            }
+
+            if (index < numbers.inputs.size()) {
+                return numbers.inputs[index]->getNumber(ctx);
+            }
+            T value;
+            if (NumberTraits<T>::fromDouble(ctx.aggregateSteps[index - numbers.inputs.size()]->getResult(ctx), value)) {
+                return value;
+            }
+            out << "The result is too large for this number type! Please try again.\n";
+            addErrorAtIndex(ctx, 1); // Error on the second screen
+        }
+    }
+
+public:
+    CalculusStep() : StatefulStep<CalculusState<T>>(NumberTraits<T>::calculusKind) {} // Default constructor
+
+
+    // Called when creating the flow, the expression can only use the steps added before this one
+    CalculusStep(OperandCounts available) : StatefulStep<CalculusState<T>>(NumberTraits<T>::calculusKind) {
+        std::cout << "---------------------------\n";
+        std::cout << "Creating Calculus Step (" << typeName() << "):\n";
+        std::cout << "Operands: n1-n" << available.numberInputs << " (" << typeName() << " number inputs), c1-c" << available.calculusSteps
+                  << " (" << typeName() << " calculus steps), a1-a" << available.aggregateSteps << " (column aggregates)\n";
+        std::cout << "For example: (n1+n2)*max(n3,c1)/2\n";
+
+        // Keep asking until the expression compiles, empty means the operands are chosen when the step runs
+        while (true) {
+            std::cout << "Expression (leave empty to choose two operands when running): ";
+            std::string text;
+            getline(std::cin, text);
+            if (text.empty()) {
+                break;
+            }
+
+            try {
+                expression = Expression(text);
+                if (!expression.fits(available)) {
+                    throw std::runtime_error("The expression uses steps that don't come before this one");
+                }
+                translate();
+                break;
+            } catch (const std::exception& e) {
+                expression = Expression();
+                std::cout << "Error: " << e.what() << "\n";
+            }
+        }
+    }
+
+
+    // Used when loading the flow from a snapshot
+    CalculusStep(std::string text) : StatefulStep<CalculusState<T>>(NumberTraits<T>::calculusKind) {
+        if (!text.empty()) {
+            expression = Expression(text);
+            translate();
+        }
+    }
+
+
+    // Returns the name of the step, with its number type unless it is a float
+    std::string getStepName() override {
+        std::string type = NumberTraits<T>::name;
+        return type.empty() ? "Calculus Step" : "Calculus Step (" + type + ")";
+    }
+
+
+    // Saves the parameters of the step
+    void saveParameters(SnapshotWriter& out) override {
+        out.writeString(expression.getText());
+    }
+
+
+    // Returns the result of the operation in the given run
+    T getResult(RunContext& ctx) {
+        return state(ctx).result;
+    }
+
+
+    // Returns what the given run produced
+    std::string getRunResult(RunContext& ctx) override {
+        return formatNumber(state(ctx).result);
+    }
+
+
+    // Displays the numbers and result on the screen
+    void displayInfoOnScreen(RunContext& ctx, std::ostream& out) override {
+        CalculusState<T>& state = this->state(ctx);
+        if (!expression.empty()) {
+            out << "Calculus Step -> Expression: " << expression.getText() << ", Result: " << state.result << "\n";
+            return;
+        }
+        out << "Calculus Step -> Number 1: " << state.number1 << ", Number 2: " << state.number2 << ", Operation: " << state.operation << ", Result: " << state.result << "\n";
+    }
+
+
+    // Called inside the output step
+    void addInfoToFile(RunContext& ctx, OutputWriter& out) override {
+        CalculusState<T>& state = this->state(ctx);
+        std::ostream& file = out.out();
+        file << "---------------------------\n";
+        file << "Calculus Step:\n";
+        if (!expression.empty()) {
+            file << "Expression: " << expression.getText() << "\n";
+        } else {
+            file << "Number 1: " << state.number1 << "\n";
+            file << "Number 2: " << state.number2 << "\n";
+            file << "Operation: " << state.operation << "\n";
+        }
+        file << "Result: " << state.result << "\n";
+    }
+
+
+    // Main function that gets called when the step is executed
+    void execute(RunContext& ctx) override {
+        std::ostream& out = ctx.out();
+        NumberSteps<T>& numbers = ctx.numbers<T>();
+        CalculusState<T>& state = this->state(ctx);
+        while (true) {
+            // Display available options
+            out << "---------------------------\n";
+            out << "Executing Calculus Step:\n";
+            out << "1. Run this step\n";
+            out << "2. Skip this step\n";
+            out << "Enter your choice: ";
+            std::string choice;
+            ctx.readLine(choice, 0);
+
+            // If the user ran the step, he can't skip it unless he finishes it
+            if (choice == "1") { // Run the step
+                if (!expression.empty()) { // The expression was compiled when the flow was created, nothing to ask
+                    OperandCounts available = {numbers.inputs.size(), numbers.calculusSteps.size(), ctx.aggregateSteps.size()};
+                    if (!expression.fits(available)) {
+                        out << "The expression uses steps that are not part of this flow!\n";
+                        addErrorAtIndex(ctx, 0); // Error on the first screen
+                        return;
+                    }
+                    CalcError error = evaluate(ctx);
+                    if (error != CalcError::None) {
+                        out << "Error: " << calcErrorMessage(error) << "\n";
+                        addErrorAtIndex(ctx, 2); // Error on the third screen
+                        return;
+                    }
+                    out << "Result of " << expression.getText() << " = " << state.result << "\n";
+                    return; // Exit and continue with the next step
+                }
+
+                if (numbers.inputs.size() == 0 && ctx.aggregateSteps.size() == 0) { // Without operands the step can't be executed
+                    out << "There are no Number Input or Column Aggregate Steps! Please create one first.\n";
+                    addErrorAtIndex(ctx, 0); // Error on the first screen
+                    return;
+                }
+
+                state.number1 = chooseOperand(ctx, "first");
+                state.number2 = chooseOperand(ctx, "second");
+
+                // Ask the user to choose an operation, can't be skipped
+                while (true) {
+                    // Display available options
+                    out << "---------------------------\n";
+                    out << "Running Calculus Step:\n";
+                    out << "Choose the operation:\n";
+                    out << "1. Addition\n";
+                    out << "2. Subtraction\n";
+                    out << "3. Multiplication\n";
+                    out << "4. Division\n";
+                    out << "5. Min\n";
+                    out << "6. Max\n";
+
+                    // Get the user's choice
+                    // Can be the number coresponding to each operation or the operation symbol
+                    out << "Enter your choice: ";
+                    std::string operationChoice;
+                    ctx.readLine(operationChoice, 2);
+
+                    Expression::OpCode op;
+                    const char* symbol = nullptr; // Min and Max are written as functions
+                    if (operationChoice == "1" || operationChoice == "+") { // Addition
+                        op = Expression::OpCode::Add;
+                        state.operation = "Addition";
+                        symbol = "+";
+                    } else if (operationChoice == "2" || operationChoice == "-") { // Subtraction
+                        op = Expression::OpCode::Subtract;
+                        state.operation = "Subtraction";
+                        symbol = "-";
+                    } else if (operationChoice == "3" || operationChoice == "*") { // Multiplication
+                        op = Expression::OpCode::Multiply;
+                        state.operation = "Multiplication";
+                        symbol = "*";
+                    } else if (operationChoice == "4" || operationChoice == "/") { // Division
+                        op = Expression::OpCode::Divide;
+                        state.operation = "Division";
+                        symbol = "/";
+                    } else if (operationChoice == "5") { // Min
+                        op = Expression::OpCode::Min;
+                        state.operation = "Min";
+                    } else if (operationChoice == "6") { // Max
+                        op = Expression::OpCode::Max;
+                        state.operation = "Max";
+                    } else {
+                        out << "Invalid operation choice!\n";
+                        addErrorAtIndex(ctx, 2); // Error on the third screen
+                        continue;
+                    }
+
+                    // Perform the calculation based on the user's choices
+                    CalcError error = calculate(op, state.number1, state.number2, state.result);
+                    if (error != CalcError::None) {
+                        out << "Error: " << calcErrorMessage(error) << std::endl;
+                        addErrorAtIndex(ctx, 2); // Error on the third screen
+                        return;
+                    }
+                    if (symbol != nullptr) {
+                        out << "Result of " << state.number1 << " " << symbol << " " << state.number2 << " = " << state.result << "\n";
+                    } else {
+                        out << "Result of " << (op == Expression::OpCode::Min ? "min(" : "max(") << state.number1 << ", " << state.number2 << ") = " << state.result << "\n";
+                    }
+                    return; // Exit and continue with the next step
+                }
+            } else if (choice == "2") { // Skip the step
+                out << "Skipping this Calculus Step...\n";
+                addSkip(ctx);
+                return;
+            } else { // Invalid choice
+                out << "Invalid choice! Please try again.\n";
+                addErrorAtIndex(ctx, 0); // Error on the first screen
+            }
+        }
+    }
+};
+
+
+// DisplayStep class
+class DisplayStep : public Step {
+private:
+    std::string filename;
+
+    bool emptyFileAndCsvSteps(RunContext& ctx) {
+        bool csv = false;
+        bool text = false;
+
+        for (auto file : ctx.textFileSteps) {
+            if (file->getName(ctx) != "NOFILE") {
+                text = true;
+            }
+        }
+
+        for (auto file : ctx.csvFileSteps) {
+            if (file->getName(ctx) != "NOFILE") {
+                csv = true;
+            }
+        }
+
+        return csv || text;
+    }
+
+
+    // Displays a file one page at a time, files of any size open instantly
+    // Files that fit on one page are displayed without asking anything
+    void displayContentsOfFile(RunContext& ctx, std::string name) {
+        std::ostream& out = ctx.out();
+        const size_t pageLines = 40;
+
+        std::unique_ptr<PagedFile> file;
+        try {
+            file.reset(new PagedFile(name));
+        } catch (const std::exception& e) {
+            out << "Error opening file: " << name << "\n";
+            return;
+        }
+
+        size_t first = 0;
+        size_t count = pageLines;
+        while (true) {
+            size_t shown = file->writeLines(out, first, count);
+            size_t next = first + shown;
+            if (!file->hasLine(next)) { // The end of the file was reached
+                return;
+            }
+
+            // Ask where to go next, can't be skipped
+            while (true) {
+                out << "---------------------------\n";
+                out << "Lines " << first + 1 << "-" << next << " of " << name << "\n";
+                out << "Press Enter for the next page, type a line number to jump to it,\n";
+                out << "a range like 100-150 to display those lines or q to stop: ";
+                std::string pageChoice;
+                ctx.readLine(pageChoice, 2);
+
+                if (pageChoice.empty()) { // Next page
+                    first = next;
+                    count = pageLines;
+                    break;
+                } else if (pageChoice == "q" || pageChoice == "Q") {
+                    return;
+                }
+
+                std::string_view answer = pageChoice;
+                size_t dash = answer.find('-');
+                size_t from = 0;
+                size_t to = 0;
+                bool valid = parseNumber(answer.substr(0, dash), from) == ParseError::None;
+                if (valid && dash == std::string_view::npos) {
+                    to = from + pageLines - 1;
+                } else if (valid) {
+                    valid = parseNumber(answer.substr(dash + 1), to) == ParseError::None;
+                }
+                if (valid && from >= 1 && to >= from && file->hasLine(from - 1)) {
+                    first = from - 1;
+                    count = to - from + 1;
+                    break;
+                }
+                out << "Invalid choice! Please try again.\n";
+                addErrorAtIndex(ctx, 2); // Error on the third screen
+            }
+        }
+    }
+
+public:
+    DisplayStep(std::string filename) : Step(StepKind::Display), filename(filename) {}
+    DisplayStep() : Step(StepKind::Display), filename("NOFILE") {} // Default constructor
+
+
+    // Returns the name of the step
+    std::string getStepName() override {
+        return "Display Step";
+    }
+
+
+    // Saves the parameters of the step
+    void saveParameters(SnapshotWriter& out) override {
+        out.writeString(filename);
+    }
+
+
+    // Displays the name of the stored file
+    void displayInfoOnScreen(RunContext& ctx, std::ostream& out) override {
+        out << "Display Step -> Filename: " << filename << "\n";
+    }
+
+
+    // Didnt really need this, it just had to be defined
+    void addInfoToFile(RunContext& ctx, OutputWriter& out) override {
+        return;
+    }
+
+
+    // Main function that gets called when the step is executed
+    void execute(RunContext& ctx) override {
+        std::ostream& out = ctx.out();
+        while (true) {
+            // Display available options
+            out << "---------------------------\n";
+            out << "Running Display Step:\n";
+            out << "1. Run this step\n";
+            out << "2. Skip this step\n";
+
+            // Get the user's choice
+            out << "Enter your choice: ";
+            std::string choice;
+            ctx.readLine(choice, 0);
+
+            if (choice == "1") { // Run the step
+
+                // If there's no previous text or csv file, display stpe gets skipped forcefully
+                if (!emptyFileAndCsvSteps(ctx)) {
+                    out << "Can't run Display Step, no file available to be displayed!\n";
+                    out << "Skipping this Display Step...\n";
+                    return;
+                }
+
+                while (true) {
+                    // Display all available text and csv files
+                    out << "---------------------------\n";
+                    out << "Display the contents of which file:\n";
+
+                    // Display a list of available TextFileStep objects and let the user choose
+                    out << "Text files:\n";
+                    for (int i = 0; i < ctx.textFileSteps.size(); i++) {
+                        out << i + 1 << ". " << ctx.textFileSteps[i]->getName(ctx) << "\n";
+                    }
+
+                    // Display a list of available CsvFileStep objects and let the user choose
+                    out << "Csv files:\n";
+                    for (int i = 0; i < ctx.csvFileSteps.size(); i++) {
+                        out << i + 1 + ctx.textFileSteps.size() << ". " << ctx.csvFileSteps[i]->getName(ctx) << "\n";
+                    }
+
+                    // Get the user's choice
+                    out << "Enter your choice: ";
+                    std::string fileChoice;
+                    ctx.readLine(fileChoice, 1);
+
+                    // Verify that the user entered a valid number and within acceptable range
+                    size_t fileIndex;
+                    if (parseChoice(fileChoice, ctx.textFileSteps.size() + ctx.csvFileSteps.size(), fileIndex) != ParseError::None) {
+                        out << "Invalid choice! Please try again.\n";
+                        addErrorAtIndex(ctx, 1); // Error on the second screen
+                    } else if (fileIndex < ctx.textFileSteps.size()) {
+                        // First if is for text files
+                        displayContentsOfFile(ctx, ctx.textFileSteps[fileIndex]->getName(ctx));
+                        return; // Exit and continue with the next step
+                    } else {
+                        // This if is for csv files
+                        displayContentsOfFile(ctx, ctx.csvFileSteps[fileIndex - ctx.textFileSteps.size()]->getName(ctx));
+                        return; // Exit and continue with the next step
+                    }
+                }
+            } else if (choice == "2") { // Skip the step
+                out << "Skipping this step...\n";
+                addSkip(ctx);
+                break;
+            } else { // Invalid choice
+                out << "Invalid choice! Please try again.\n";
+                addErrorAtIndex(ctx, 0); // Error on the first screen
+            }
+        }
+    }
+};
+
+
+// What an OutputStep keeps for every run
+struct OutputState {
+    std::string title;
+    std::string description;
+};
+
+
+// The title and description of the report are entered when the step runs, the ones set here are only
+// kept so the snapshot layout of the step doesn't change
+class OutputStep : public StatefulStep<OutputState> {
+private:
+    std::string title;
+    std::string description;
+    std::string previousInfo;
+
+    void displayContentsOfFile(std::string name, OutputWriter& file) {
+        addContentsFromFirstFileToSecond(name, file);
+    }
+
+public:
+    OutputStep(std::string title, std::string description, std::string previousInfo) : StatefulStep(StepKind::Output), title(title), description(description), previousInfo(previousInfo) {}
+    OutputStep() : StatefulStep(StepKind::Output), title("NO TITLE"), description("NO DESCRIPTION"), previousInfo("NO PREVIOUS INFO") {} // Default constructor
+
+
+    // Returns the name of the step
+    std::string getStepName() override {
+        return "Output Step";
+    }
+
+
+    // Saves the parameters of the step
+    void saveParameters(SnapshotWriter& out) override {
+        out.writeString(title);
+        out.writeString(description);
+        out.writeString(previousInfo);
+    }
+
+
+    // Don't really need this
+    void displayInfoOnScreen(RunContext& ctx, std::ostream& out) override {
+        return;
+    }
+
+
+    // Don't really need this
+    void addInfoToFile(RunContext& ctx, OutputWriter& out) override {
+        return;
+    }
+
+
+    // Adds the description entered in the given run to the output file
+    void AddDescriptionToFile(RunContext& ctx, OutputWriter& file) {
+        file.out() << state(ctx).description;
+    }
+
+
+    // Main function that gets called when the step is executed
+    void execute(RunContext& ctx) override {
+        std::ostream& out = ctx.out();
+        OutputState& state = this->state(ctx);
+        std::string choice;
+        while (true) {
+            // Display available options
+            out << "---------------------------\n";
+            out << "Running Output Step:\n";
+            out << "1. Run this step\n";
+            out << "2. Skip this step\n";
+
+            // Get the user's choice
+            out << "Enter your choice: ";
+            ctx.readLine(choice, 0);
+
+            if (choice == "1") { // Run the step
+                out << "---------------------------\n";
+
+                // Ask for the name of the output file that should be created
+                out << "Enter the title of the output: ";
+                ctx.readLine(state.title, 1);
+
+                // Ask for the description of the output file
+                out << "Enter the description of the output: ";
+                ctx.readLine(state.description, 1);
+
+                // Set the state of the run to the respective value
+                state.description += "\n";
+
+                // One writer for the whole report, every step writes through it
+                // The report is written in the background, the run only waits for it at its end
+                OutputWriter report(state.title + ".txt", 1 << 20, &WriteBehind::shared(), ReportFormat::current());
+                if (!report.isOpen()) {
+                    out << "Error opening file: " << state.title << ".txt\n";
+                }
+
+                // Add the description to the output file
+                AddDescriptionToFile(ctx, report);
+
+                if (ctx.steps.size() == 1) { // If there are no steps in the flow, the output step gets skipped forcefully
+                    out << "There are no previous steps to be added!\n";
+                    out << "Skipping this Output Step...\n";
+                    report.close();
+                    ctx.addPendingReport(report.getPending(state.title + ".txt"));
+                    return;
+                }
+
+                std::string prevChoice = "0";
+
+                // User is asked to add information from previous steps until he choses "n" or "N"
+                while (prevChoice != "y" || prevChoice != "Y" || prevChoice != "n" || prevChoice != "N") {
+                    // Prompt the user to add info from a previous step
+                    out << "---------------------------\n";
+                    out << "Do you want to display a previous step's info? (y/n): ";
+                    ctx.readLine(prevChoice, 1);
+
+                    // Add info from a previous step
+                    if (prevChoice == "y" || prevChoice == "Y") {
+                        out << "---------------------------\n";
+                        out << "Which step do you want to add?\n";
+
+                        // Display a list of available TextFileStep objects and let the user choose
+                        for (int i = 0; i < ctx.steps.size() - 1; i++) {
+                            out << i + 1 << ". ";
+                            ctx.steps[i]->displayInfoOnScreen(ctx, out);
+                        }
+
+                        // Get the user's choice
+                        out << "\nEnter your choice: ";
+                        std::string stepChoice;
+                        ctx.readLine(stepChoice, 2);
+
+                        // Verify that the user entered a valid number and within acceptable range
+                        size_t stepIndex;
+                        if (parseChoice(stepChoice, ctx.steps.size(), stepIndex) == ParseError::None) {
+                            // Add the info from the chosen step to the output file
+                            ctx.steps[stepIndex]->addInfoToFile(ctx, report);
+                        } else { // Invalid choice
+                            out << "Invalid choice! Please try again.\n";
+                            addErrorAtIndex(ctx, 2); // Error on the second screen
+                        }
+                    } else if (prevChoice == "n" || prevChoice == "N") { // The user chose not to add any more info
+                        report.close(); // The report is flushed once, at the end
+                        ctx.addPendingReport(report.getPending(state.title + ".txt"));
+                        return;
+                    } else { // Invalid choice
+                        out << "Invalid choice! Please try again.\n";
+                        addErrorAtIndex(ctx, 1); // Error on the second screen
+                    }
+                }
+            } else if (choice == "2") {
+                out << "Skipping this step...\n";
+                addSkip(ctx);
+                break;
+            } else {
+                out << "Invalid choice! Please try again.\n";
+                addErrorAtIndex(ctx, 0); // Error on the first screen
+            }
+        }
+    }
+};
+
+
+// Reads a counter of a flow snapshot record, counters were 32 bits before version 3
+uint64_t readCounter(SnapshotReader& in) {
+    return in.getVersion() >= 3 ? in.readU64() : in.readU32();
+}
+
+
+// Creates a step from its snapshot record inside the given arena
+Step* loadStep(SnapshotReader& in, StepArena& arena) {
+    StepKind kind = static_cast<StepKind>(in.readU8());
+
+    // The counters come right after the kind
+    uint64_t errors[3];
+    for (int i = 0; i < 3; i++) {
+        errors[i] = readCounter(in);
+    }
+    uint64_t skips = readCounter(in);
+
+    Step* step = nullptr;
+    if (kind == StepKind::Title) {
+        std::string title = in.readString();
+        std::string subtitle = in.readString();
+        step = arena.create<TitleStep>(title, subtitle);
+    } else if (kind == StepKind::Text) {
+        std::string title = in.readString();
+        std::string copy = in.readString();
+        step = arena.create<TextStep>(title, copy);
+    } else if (kind == StepKind::TextInput) {
+        step = arena.create<TextInput>(in.readString());
+    } else if (kind == StepKind::NumberInput) {
+        step = arena.create<NumberInput<float>>(in.readString());
+    } else if (kind == StepKind::IntegerInput) {
+        step = arena.create<NumberInput<int64_t>>(in.readString());
+    } else if (kind == StepKind::DoubleInput) {
+        step = arena.create<NumberInput<double>>(in.readString());
+    } else if (kind == StepKind::DecimalInput) {
+        step = arena.create<NumberInput<Decimal>>(in.readString());
+    } else if (kind == StepKind::Calculus) {
+        // Calculus steps have kept their expression since version 2
+        step = arena.create<CalculusStep<float>>(in.getVersion() >= 2 ? in.readString() : "");
+    } else if (kind == StepKind::IntegerCalculus) {
+        step = arena.create<CalculusStep<int64_t>>(in.readString());
+    } else if (kind == StepKind::DoubleCalculus) {
+        step = arena.create<CalculusStep<double>>(in.readString());
+    } else if (kind == StepKind::DecimalCalculus) {
+        step = arena.create<CalculusStep<Decimal>>(in.readString());
+    } else if (kind == StepKind::TextFile) {
+        step = arena.create<TextFileStep>(in.readString());
+    } else if (kind == StepKind::CsvFile) {
+        step = arena.create<CsvFileStep>(in.readString());
+    } else if (kind == StepKind::ColumnAggregate) {
+        step = arena.create<ColumnAggregateStep>(in.readString());
+    } else if (kind == StepKind::Display) {
+        step = arena.create<DisplayStep>(in.readString());
+    } else if (kind == StepKind::Output) {
+        std::string title = in.readString();
+        std::string description = in.readString();
+        std::string previousInfo = in.readString();
+        step = arena.create<OutputStep>(title, description, previousInfo);
+    } else {
+        throw std::runtime_error("The flow snapshot contains an unknown step");
+    }
+
+    step->loadCounters(errors[0], errors[1], errors[2], skips);
+    return step;
+}
+
+
+// Returns how many strings follow the counters of a step record, has to match loadStep
+// Every parameter of a step is saved as a string, so a record can be skipped without creating the step
+int stepParameterCount(StepKind kind, uint32_t version) {
+    switch (kind) {
+    case StepKind::Title:
+    case StepKind::Text:
+        return 2;
+    case StepKind::Output:
+        return 3;
+    case StepKind::Calculus:
+        return version >= 2 ? 1 : 0;
+    case StepKind::TextInput:
+    case StepKind::NumberInput:
+    case StepKind::IntegerInput:
+    case StepKind::DoubleInput:
+    case StepKind::DecimalInput:
+    case StepKind::IntegerCalculus:
+    case StepKind::DoubleCalculus:
+    case StepKind::DecimalCalculus:
+    case StepKind::TextFile:
+    case StepKind::CsvFile:
+    case StepKind::ColumnAggregate:
+    case StepKind::Display:
+        return 1;
+    }
+    throw std::runtime_error("The flow snapshot contains an unknown step");
+}
+
+
+// The counters of many flows, one vector per column
+// The steps of all flows are stored one flow after the other, flowStepCounts says how many belong to each flow
+struct AnalyticsTable {
+    std::vector<std::string> flowNames;
+    std::vector<uint64_t> flowStarted;
+    std::vector<uint32_t> flowStepCounts;
+    std::vector<uint8_t> stepKinds;
+    std::vector<uint64_t> stepErrors[3]; // One column per screen
+    std::vector<uint64_t> stepSkips;
+    FileCacheStats fileCache; // Process wide, not per flow
+    WriteBehindStats writes; // Process wide, not per flow
+};
+
+
+// The number inputs and calculus steps of one number type of a flow, in order
+template <typename T>
+struct NumberIndex {
+    std::vector<NumberInput<T>*> inputs;
+    std::vector<CalculusStep<T>*> calculusSteps;
+};
+
+
+// Flow class
+class Flow {
+private:
+    StepArena arena; // Owns the steps of the flow, they are destroyed with it
+    ShardedCounters<1> started; // Number of times the flow was started, runs on several threads can start it at once
+    LatencyHistogram runTimes; // How long the completed runs of the flow took, kept for this session only
+    std::vector<Step*> steps; // Stores all steps of the flow
+    NumberIndex<float> floats; // The NumberInputStep and CalculusStep objects of the flow, one set per number type
+    NumberIndex<int64_t> integers;
+    NumberIndex<double> doubles;
+    NumberIndex<Decimal> decimals;
+    std::vector<TextFileStep*> textFileSteps; // The TextFileStep objects of the flow, in order
+    std::vector<CsvFileStep*> csvFileSteps; // The CsvFileStep objects of the flow, in order
+    std::vector<ColumnAggregateStep*> aggregateSteps; // The ColumnAggregateStep objects of the flow, in order
+    StateLayout stateLayout; // Where the steps keep what a run enters, every run gets a block of its own
+    std::string name; // Name of the flow
+    std::string createdDate; // Date and time when the flow was created
+    uint64_t definitionHash = 0; // Hash of the name and of the definition of every step, continued by addStep
+
+
+    // Adds a step that lives in the arena of the flow
+    // The steps the other steps pick from are indexed here once, instead of on every run
+    void addStep(Step* step) {
+        if (step == nullptr) {
+            return;
+        }
+
+        SnapshotWriter definition;
+        step->saveDefinition(definition);
+        definitionHash = hash64(definition.getBuffer().data(), definition.getSize(), definitionHash);
+
+        steps.push_back(step);
+        step->reserveState(stateLayout);
+        switch (step->getKind()) {
+        case StepKind::NumberInput:
+            floats.inputs.push_back(static_cast<NumberInput<float>*>(step));
+            break;
+        case StepKind::IntegerInput:
+            integers.inputs.push_back(static_cast<NumberInput<int64_t>*>(step));
+            break;
+        case StepKind::DoubleInput:
+            doubles.inputs.push_back(static_cast<NumberInput<double>*>(step));
+            break;
+        case StepKind::DecimalInput:
+            decimals.inputs.push_back(static_cast<NumberInput<Decimal>*>(step));
+            break;
+        case StepKind::Calculus:
+            floats.calculusSteps.push_back(static_cast<CalculusStep<float>*>(step));
+            break;
+        case StepKind::IntegerCalculus:
+            integers.calculusSteps.push_back(static_cast<CalculusStep<int64_t>*>(step));
+            break;
+        case StepKind::DoubleCalculus:
+            doubles.calculusSteps.push_back(static_cast<CalculusStep<double>*>(step));
+            break;
+        case StepKind::DecimalCalculus:
+            decimals.calculusSteps.push_back(static_cast<CalculusStep<Decimal>*>(step));
+            break;
+        case StepKind::TextFile:
+            textFileSteps.push_back(static_cast<TextFileStep*>(step));
+            break;
+        case StepKind::CsvFile:
+            csvFileSteps.push_back(static_cast<CsvFileStep*>(step));
+            break;
+        case StepKind::ColumnAggregate:
+            aggregateSteps.push_back(static_cast<ColumnAggregateStep*>(step));
+            break;
+        default:
+            break;
+        }
+    }
+
+public:
+    Flow(std::string name) : name(name), definitionHash(hash64(name.data(), name.size())) { // Constructor
+        // Set the createdDate to the current date and time
+        std::time_t now = std::time(nullptr);
+        createdDate = std::asctime(std::localtime(&now));
+    }
+
+
+    // Recreates a flow from its snapshot record
+    Flow(SnapshotReader& in) {
+        name = in.readString();
+        definitionHash = hash64(name.data(), name.size());
+        createdDate = in.readString();
+        started.set(0, readCounter(in));
+
+        uint32_t stepCount = in.readU32();
+        for (uint32_t i = 0; i < stepCount; i++) {
+            addStep(loadStep(in, arena));
+        }
+    }
+
+
+    // Writes the flow and all of its steps, the name and date come first so the
+    // catalog can list a flow without loading it
+    void save(SnapshotWriter& out) {
+        out.writeString(name);
+        out.writeString(createdDate);
+        out.writeU64(started.get(0));
+        out.writeU32(steps.size());
+        for (auto step : steps) {
+            step->save(out);
+        }
+    }
+
+
+    // Returns the number of times the flow was started
+    uint64_t getStarted() {
+        return started.get(0);
+    }
+
+
+    // Returns the steps of the flow
+    std::vector<Step*> getStep() {
+        return steps;
+    }
+
+
+    // Returns how many steps an expression of type T added now could refer to
+    template <typename T>
+    OperandCounts getOperandCounts() {
+        NumberIndex<T>* numbers;
+        if constexpr (std::is_same_v<T, float>) {
+            numbers = &floats;
+        } else if constexpr (std::is_same_v<T, int64_t>) {
+            numbers = &integers;
+        } else if constexpr (std::is_same_v<T, double>) {
+            numbers = &doubles;
+        } else {
+            numbers = &decimals;
+        }
+        return {numbers->inputs.size(), numbers->calculusSteps.size(), aggregateSteps.size()};
+    }
+
+
+    // Returns the name of the flow
+    std::string getName() {
+        return name;
+    }
+
+
+    // Returns a hash of the name and the steps of the flow, two flows with the same name and steps have the same hash
+    uint64_t getDefinitionHash() {
+        return definitionHash;
+    }
+
+
+    // Returns the date and time when the flow was created
+    std::string getCreatedDate() {
+        return createdDate;
+    }
+
+
+    // If a flow is started it cannot be skipped
+    // So the number of times the flow is started is the number of times it was completed
+    void addStart() {
+        started.add(0);
+    }
+
+
+    // Creates a step of the flow in its arena and adds it at the end
+    template <typename T, typename... Args>
+    T* createStep(Args&&... args) {
+        T* step = arena.create<T>(std::forward<Args>(args)...);
+        addStep(step);
+        return step;
+    }
+
+
+    // Returns the number of bytes a run of the flow needs for the states of its steps
+    size_t getStateSize() {
+        return stateLayout.getSize();
+    }
+
+
+    // Displays how much memory the steps of the flow take up, once and for every run
+    void displayStorage() {
+        std::cout << "---------------------------\n";
+        std::cout << "Step storage: " << arena.getStepCount() << " steps, " << arena.getBytesUsed() << " bytes used of "
+                  << arena.getBytesReserved() << " bytes in " << arena.getBlockCount() << " blocks\n";
+        std::cout << "Run state: " << stateLayout.getSize() << " bytes per run\n";
+    }
+
+
+    // Displays the skips for each step
+    void displaySkips() {
+        std::cout << "---------------------------\n";
+        std::cout << "Skips for each step:\n";
+
+        // Loop through all steps of the flow
+        for (size_t i = 0; i < steps.size(); i++) {
+            // Display the name of the step and the number of times it was skipped
+            std::cout << "Step " << i + 1 << ", " << steps[i]->getStepName() << ": Skipped = " << steps[i]->getSkips() << "\n";
+        }
+    }
+
+
+    // Displays the errors for each step on each screen
+    void displayErrors() {
+        std::cout << "---------------------------\n";
+        std::cout << "Errors for each step:\n";
+        
+        for (size_t i = 0; i < steps.size(); i++) {
+            // Displays the name of the step and the number of times it was skipped
+            std::cout << "Step " << i + 1 << ", " << steps[i]->getStepName() << ":\n";
+            steps[i]->displayErrors();
+        }
+    }
+
+
+    // Displays starts and completes
+    void displayStartAndCompletes() {
+        std::cout << "---------------------------\n";
+        std::cout << "Started: " << started.get(0) << "\n";
+        std::cout << "Completed: " << started.get(0) << "\n";
+    }
+
+
+    // Displays the average errors for each flow
+    void displayAverageErrors() {
+        uint64_t allErrors = 0; // Count all errors from each step
+        for (auto step : steps) {
+            allErrors += step->totalErrors();
+        }
+
+        // Display the average errors per flow started
+        std::cout << "---------------------------\n";
+        std::cout << "Average errors per flow: " << (float)allErrors / steps.size() / started.get(0) << "\n";
+    }
+
+
+    // Appends the counters of the flow and its steps to the table
+    // The counters are read without stopping the runs that are counting at the same time
+    void collectCounters(AnalyticsTable& table) {
+        table.flowNames.push_back(name);
+        table.flowStarted.push_back(started.get(0));
+        table.flowStepCounts.push_back(steps.size());
+        for (auto step : steps) {
+            table.stepKinds.push_back(static_cast<uint8_t>(step->getKind()));
+            for (int i = 0; i < 3; i++) {
+                table.stepErrors[i].push_back(step->getErrorsAtIndex(i));
+            }
+            table.stepSkips.push_back(step->getSkips());
+        }
+    }
+
+
+    // Displays the p50, p99 and p999 latencies of the flow, of each step and of each screen of a step
+    void displayLatencies() {
+        std::cout << "---------------------------\n";
+        std::cout << "Latencies of this session:\n";
+        std::cout << "Flow: ";
+        runTimes.display(std::cout);
+
+        for (size_t i = 0; i < steps.size(); i++) {
+            const StepTimings* timings = steps[i]->findTimings();
+            if (timings == nullptr) {
+                continue; // The step never ran in this session
+            }
+
+            std::cout << "Step " << i + 1 << " (" << steps[i]->getStepName() << "): ";
+            timings->execute.display(std::cout);
+            for (int screen = 0; screen < 3; screen++) {
+                if (timings->screens[screen].count() > 0) {
+                    std::cout << "    Screen " << screen + 1 << ": ";
+                    timings->screens[screen].display(std::cout);
+                }
+            }
+        }
+    }
+
+    
+    // Points the lists of the run at the indexes of this flow and gives every step a fresh state for the run
+    void prepare(RunContext& ctx) {
+        ctx.resetState(stateLayout);
+        ctx.steps.reset(steps);
+        ctx.floats.inputs.reset(floats.inputs);
+        ctx.floats.calculusSteps.reset(floats.calculusSteps);
+        ctx.integers.inputs.reset(integers.inputs);
+        ctx.integers.calculusSteps.reset(integers.calculusSteps);
+        ctx.doubles.inputs.reset(doubles.inputs);
+        ctx.doubles.calculusSteps.reset(doubles.calculusSteps);
+        ctx.decimals.inputs.reset(decimals.inputs);
+        ctx.decimals.calculusSteps.reset(decimals.calculusSteps);
+        ctx.textFileSteps.reset(textFileSteps);
+        ctx.csvFileSteps.reset(csvFileSteps);
+        ctx.aggregateSteps.reset(aggregateSteps);
+    }
+
+
+    // Makes a step and its index entry visible to the steps that come after it
+    void reveal(RunContext& ctx, Step* step) {
+        switch (step->getKind()) {
+        case StepKind::NumberInput:
+            ctx.floats.inputs.reveal();
+            break;
+        case StepKind::IntegerInput:
+            ctx.integers.inputs.reveal();
+            break;
+        case StepKind::DoubleInput:
+            ctx.doubles.inputs.reveal();
+            break;
+        case StepKind::DecimalInput:
+            ctx.decimals.inputs.reveal();
+            break;
+        case StepKind::Calculus:
+            ctx.floats.calculusSteps.reveal();
+            break;
+        case StepKind::IntegerCalculus:
+            ctx.integers.calculusSteps.reveal();
+            break;
+        case StepKind::DoubleCalculus:
+            ctx.doubles.calculusSteps.reveal();
+            break;
+        case StepKind::DecimalCalculus:
+            ctx.decimals.calculusSteps.reveal();
+            break;
+        case StepKind::TextFile:
+            ctx.textFileSteps.reveal();
+            break;
+        case StepKind::CsvFile:
+            ctx.csvFileSteps.reveal();
+            break;
+        case StepKind::ColumnAggregate:
+            ctx.aggregateSteps.reveal();
+            break;
+        default:
+            break;
+        }
+        ctx.steps.reveal();
+    }
+
+
+    // Executes all steps of the flow
+    void execute(RunContext& ctx) {
+        std::ostream& out = ctx.out();
+        out << "---------------------------\n";
+        out << "Executing flow: " << name << "\n";
+
+        prepare(ctx);
+        ctx.startRun(name, definitionHash);
+
+        // Loop through all steps of the flow, the clock is read once between two steps
+        uint64_t runStart = monotonicNanos();
+        uint64_t stepStart = runStart;
+        try {
+            for (auto step : steps) {
+                reveal(ctx, step);
+                StepTimings& timings = step->getTimings();
+                ctx.beginStep(&timings, stepStart);
+                ctx.recordStep(static_cast<uint8_t>(step->getKind()));
+                step->execute(ctx);
+                if (ctx.isJournaled()) {
+                    ctx.recordResult(step->getRunResult(ctx));
+                }
+
+                uint64_t now = monotonicNanos();
+                timings.execute.record(now - stepStart);
+                stepStart = now;
+            }
+        } catch (...) {
+            // A run that stops halfway is journaled too
+            ctx.awaitReports();
+            ctx.beginStep(nullptr, stepStart);
+            ctx.finishRun(false);
+            throw;
+        }
+        ctx.awaitReports(); // The reports are on disk before the run counts as done
+        stepStart = monotonicNanos();
+        ctx.beginStep(nullptr, stepStart);
+        runTimes.record(stepStart - runStart);
+        ctx.finishRun(true);
+
+        // Display a confirmation that the flow was executed
+        out << "---------------------------\n";
+        out << "---------------------------\n";
+        out << "Flow execution is done!\n";
+        out << "Going back to the start page.\n";
+    }
+};
+
+
+// Outcome of a headless run
+struct RunResult {
+    bool completed = false; // False if the run stopped before the last step
+    size_t answersUsed = 0; // How many answers the run consumed
+    std::string error; // Why the run stopped, empty if it completed
+};
+
+
+// Executes a flow without a terminal, every prompt is answered from the given answers
+// The errors and skips are counted exactly like in an interactive run
+RunResult runFlowScripted(Flow* flow, const std::vector<std::string>& answers, RunJournal* journal = nullptr) {
+    RunResult result;
+    ScriptedIO io(answers);
+    RunContext ctx(io, journal);
+
+    flow->addStart();
+    try {
+        flow->execute(ctx);
+        result.completed = true;
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+
+    result.answersUsed = io.getAnswersUsed();
+    return result;
+}
+
+
+// One run to be launched by runFlowsParallel
+struct RunRequest {
+    Flow* flow;
+    const std::vector<std::string>* answers;
+};
+
+
+// Executes every requested run headless, spread over the given number of threads
+// The results are returned in the same order as the requests
+std::vector<RunResult> runFlowsParallel(const std::vector<RunRequest>& requests, unsigned threadCount, RunJournal* journal = nullptr) {
+    std::vector<RunResult> results(requests.size());
+    std::atomic<size_t> next(0); // Index of the next request to be picked up
+
+    // Every thread keeps picking up requests until there are none left
+    auto worker = [&]() {
+        size_t index;
+        while ((index = next.fetch_add(1)) < requests.size()) {
+            results[index] = runFlowScripted(requests[index].flow, *requests[index].answers, journal);
+        }
+    };
+
+    if (threadCount < 1) {
+        threadCount = 1;
+    }
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    worker(); // The calling thread works too
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    return results;
+}
+
+
+// Outcome of replaying the recorded runs of a flow
+struct ReplayResult {
+    size_t replayed = 0;
+    size_t otherDefinition = 0; // Runs of a flow with the same name but other steps, they aren't replayed
+    size_t diverged = 0; // Runs that didn't end the way they did when they were recorded
+    std::string firstDivergence; // What happened to the first run that diverged
+};
+
+
+// Replays the recorded runs of a flow headless, every run gets exactly the answers it read when it was recorded
+// A run belongs to the flow if it has its name and, when the record has one, its definition hash
+// A run diverges if it doesn't use up its answers or doesn't end the same way, which means the flow or the
+// files it reads changed since the recording. With a single thread the runs happen in their recorded order,
+// so the counters and the output files end up exactly as they did
+ReplayResult replayRuns(Flow* flow, const std::vector<RecordedRun>& runs, unsigned threadCount) {
+    std::vector<RunRequest> requests;
+    std::vector<const RecordedRun*> replayed;
+    ReplayResult replay;
+    for (auto& run : runs) {
+        if (run.flowName != flow->getName()) {
+            continue;
+        }
+        if (run.definition != 0 && run.definition != flow->getDefinitionHash()) {
+            replay.otherDefinition++;
+            continue;
+        }
+        requests.push_back(RunRequest{flow, &run.answers});
+        replayed.push_back(&run);
+    }
+
+    std::vector<RunResult> results = runFlowsParallel(requests, threadCount);
+
+    replay.replayed = results.size();
+    for (size_t i = 0; i < results.size(); i++) {
+        if (results[i].completed != replayed[i]->completed || results[i].answersUsed != replayed[i]->answers.size()) {
+            if (replay.diverged == 0) {
+                replay.firstDivergence = "run " + std::to_string(i + 1) + " used " + std::to_string(results[i].answersUsed) + " of "
+                    + std::to_string(replayed[i]->answers.size()) + " answers" + (results[i].error.empty() ? "" : ", " + results[i].error);
+            }
+            replay.diverged++;
+        }
+    }
+    return replay;
+}
+
+
+// Reads an answer file, every line is the answer to one prompt
+std::vector<std::string> loadAnswerScript(std::string name) {
+    std::ifstream file(name);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening file: " + name);
+    }
+
+    std::vector<std::string> answers;
+    std::string line;
+    while (std::getline(file, line)) {
+        // Answer files written on Windows keep the carriage return
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        answers.push_back(line);
+    }
+
+    return answers;
+}
+
+
+// Stable handle of a flow in the catalog, it keeps pointing to the same flow while others are added or removed
+// and never points to another flow once its own is removed
+struct FlowId {
+    uint32_t slot = 0;
+    uint32_t generation = 0;
+};
+
+
+// Stores all the flows and keeps them on disk between restarts
+// The snapshot is memory mapped and a flow is only loaded the first time it is needed,
+// so the startup time doesn't grow with the number or the size of the flows
+// Flows live in slots that are reused once their flow is removed, so finding, adding and removing a flow
+// takes the same time however many there are. Names are indexed the first time a flow is looked up by name.
+// The flows are listed in the order they were added: a removed flow leaves a hole in the list, a tree of counts
+// over the list finds the n-th flow past the holes, and the holes are dropped once they outnumber the flows.
+// Added and removed flows are appended to a change log next to the snapshot, which is replayed on open,
+// so saving a change doesn't rewrite every flow. The log is folded into a new snapshot once it gets as large
+//
+// Snapshot layout:
+//   header: magic (8 bytes), version (u32), flow count (u32), index offset (u64)
+//   one record per flow, written by Flow::save
+//   index: offset (u64) and size (u64) of every flow record
+//
+// Change log layout (the snapshot path followed by .log):
+//   header: magic (8 bytes), version (u32), device, inode, size and modification time of the snapshot (u64 each),
+//   frame key (u32)
+//   one change per frame (see FrameFormat), either
+//   Add (u8) and the flow record, or Remove (u8) and the position of the flow in the list (u32)
+class FlowCatalog {
+private:
+    // A flow is either loaded or still just a record inside the snapshot
+    struct Entry {
+        Flow* flow = nullptr;
+        uint64_t offset = 0;
+        uint64_t size = 0;
+    };
+
+    // Kinds of changes in the change log
+    enum class Change : uint8_t {
+        Add = 1,
+        Remove
+    };
+
+    static constexpr char magic[8] = {'F', 'L', 'O', 'W', 'S', 'N', 'A', 'P'};
+    static const uint32_t version = 3; // Version 2 added the expression of the calculus steps, version 3 made the counters 64 bits
+    static const size_t headerSize = 24;
+    static constexpr char logMagic[8] = {'F', 'L', 'O', 'W', 'L', 'O', 'G', 'S'};
+    static const uint32_t logVersion = 2; // Version 2 added the frame key, magic and sequence numbers
+    static const uint32_t changeMagic = 0x474e4843; // "CHNG" in the file
+    static const size_t logHeaderSize = 48;
+    static const uint64_t minLogSize = 1 << 20; // The log is folded into the snapshot once it's larger than this and the snapshot
+    static const uint32_t hole = UINT32_MAX; // Place of a removed flow in order
+
+    // A flow and the generation of the slot, which changes every time the slot is freed
+    struct Slot {
+        Entry entry;
+        uint32_t generation = 0;
+        uint32_t position = 0; // Where the slot is in order
+    };
+
+    std::string path; // Where the snapshot is stored
+    std::string logPath; // Where the changes made since the snapshot was saved are stored
+    std::unique_ptr<MappedFile> snapshot; // Null until the first snapshot exists
+    uint32_t snapshotVersion = version; // The version the mapped snapshot was written by
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    std::vector<uint32_t> order; // The slot of every flow, in the order they are listed and saved, with holes
+    std::vector<uint32_t> counts; // Fenwick tree over order, every flow counts 1 and every hole 0
+    size_t flowCount = 0;
+    std::unordered_multimap<std::string, uint32_t> names; // Slot of every flow by its name, names don't have to be unique
+    bool namesIndexed = false;
+    SnapshotWriter changes; // Framed changes not written to the log yet
+    uint64_t logSize = 0; // Bytes of the log of the mapped snapshot, 0 if there is none
+    FrameFormat logFrames{changeMagic, FrameFormat::newKey()};
+    uint32_t loggedChanges = 0; // Changes in the log, the next one appended gets this sequence number
+    uint32_t pendingChanges = 0; // Changes framed in changes
+
+
+    // Returns the entry of a flow, throws if the flow was removed
+    Entry& entryOf(FlowId id) {
+        if (id.slot >= slots.size() || slots[id.slot].generation != id.generation) {
+            throw std::runtime_error("The flow no longer exists");
+        }
+        return slots[id.slot].entry;
+    }
+
+
+    // Returns the name of the flow in an entry without loading it
+    std::string nameOf(Entry& entry) {
+        if (entry.flow != nullptr) {
+            return entry.flow->getName();
+        }
+        return recordReader(entry).readString();
+    }
+
+
+    // Indexes the names of all flows, done once
+    void indexNames() {
+        if (namesIndexed) {
+            return;
+        }
+        names.reserve(flowCount);
+        for (uint32_t slot : order) {
+            if (slot != hole) {
+                names.emplace(nameOf(slots[slot].entry), slot);
+            }
+        }
+        namesIndexed = true;
+    }
+
+
+    // Returns a reader positioned at the start of a flow record
+    SnapshotReader recordReader(Entry& entry) {
+        if (entry.offset + entry.size > snapshot->getSize()) {
+            throw std::runtime_error("The flow snapshot is corrupted");
+        }
+        return SnapshotReader(snapshot->getData() + entry.offset, entry.size, snapshotVersion);
+    }
+
+
+    // Loads a flow from the snapshot if it wasn't already
+    Flow* load(Entry& entry) {
+        if (entry.flow == nullptr) {
+            SnapshotReader in = recordReader(entry);
+            entry.flow = new Flow(in);
+        }
+        return entry.flow;
+    }
+
+
+    // Returns how many flows are listed before the given position of order
+    size_t countBefore(size_t position) {
+        size_t count = 0;
+        for (size_t i = position; i > 0; i -= i & (~i + 1)) {
+            count += counts[i - 1];
+        }
+        return count;
+    }
+
+
+    // Returns the position in order of the flow listed at the given index, skipping the holes
+    size_t positionOf(size_t index) {
+        size_t position = 0;
+        size_t remaining = index + 1;
+        size_t step = 1;
+        while (step * 2 <= counts.size()) {
+            step *= 2;
+        }
+        for (; step > 0; step /= 2) {
+            if (position + step <= counts.size() && counts[position + step - 1] < remaining) {
+                position += step;
+                remaining -= counts[position - 1];
+            }
+        }
+        return position;
+    }
+
+
+    // Drops the holes of order and rebuilds the counts, every flow keeps its place in the list
+    void compactOrder() {
+        size_t kept = 0;
+        for (uint32_t slot : order) {
+            if (slot != hole) {
+                slots[slot].position = kept;
+                order[kept++] = slot;
+            }
+        }
+        order.resize(kept);
+        counts.resize(kept);
+        for (size_t i = 1; i <= kept; i++) {
+            counts[i - 1] = i & (~i + 1); // Every position holds a flow, so a node counts the positions it covers
+        }
+    }
+
+
+    // Adds a flow at the end of the list without logging it
+    FlowId insert(Flow* flow) {
+        uint32_t slot;
+        if (freeSlots.empty()) {
+            slot = slots.size();
+            slots.emplace_back();
+        } else {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        slots[slot].entry = Entry();
+        slots[slot].entry.flow = flow;
+        slots[slot].position = order.size();
+        order.push_back(slot);
+
+        // The new node of the tree covers the new flow and the nodes below it
+        size_t node = order.size();
+        uint32_t count = 1;
+        for (size_t child = 1; child < (node & (~node + 1)); child *= 2) {
+            count += counts[node - child - 1];
+        }
+        counts.push_back(count);
+        flowCount++;
+
+        if (namesIndexed) {
+            names.emplace(flow->getName(), slot);
+        }
+        return FlowId{slot, slots[slot].generation};
+    }
+
+
+    // Removes a flow without logging it, the flows after it keep their order
+    void erase(FlowId id) {
+        Entry& entry = entryOf(id);
+        if (namesIndexed) {
+            auto range = names.equal_range(nameOf(entry));
+            for (auto match = range.first; match != range.second; match++) {
+                if (match->second == id.slot) {
+                    names.erase(match);
+                    break;
+                }
+            }
+        }
+        delete entry.flow;
+        entry = Entry();
+
+        Slot& removed = slots[id.slot];
+        order[removed.position] = hole;
+        for (size_t i = removed.position + 1; i <= counts.size(); i += i & (~i + 1)) {
+            counts[i - 1]--;
+        }
+        flowCount--;
+        removed.generation++;
+        freeSlots.push_back(id.slot);
+
+        if (order.size() - flowCount > flowCount) {
+            compactOrder();
+        }
+    }
+
+
+    // Frames a change and keeps it until the next persist
+    void logChange(SnapshotWriter& change) {
+        logFrames.append(changes.getBuffer(), loggedChanges + pendingChanges, change.getBuffer().data(), change.getSize());
+        pendingChanges++;
+    }
+
+
+    // Applies the changes logged since the snapshot was saved
+    // A log that belongs to another snapshot is left over from a save that stopped before deleting it, so it is
+    // deleted. A change cut off at the end was being written when the program stopped, it is left out
+    void replayLog() {
+        if (access(logPath.c_str(), F_OK) != 0) {
+            return;
+        }
+        if (snapshot == nullptr) {
+            ::remove(logPath.c_str());
+            return;
+        }
+
+        MappedFile log(logPath);
+        const char* data = log.getData();
+        size_t size = log.getSize();
+        const FileIdentity& identity = snapshot->getIdentity();
+        SnapshotReader header(data, size, logVersion);
+        bool matches = size >= logHeaderSize;
+        for (size_t i = 0; matches && i < sizeof(logMagic); i++) {
+            matches = header.readU8() == static_cast<uint8_t>(logMagic[i]);
+        }
+        if (matches && header.readU32() != logVersion) {
+            throw std::runtime_error(logPath + " was written by an unsupported version");
+        }
+        matches = matches && header.readU64() == static_cast<uint64_t>(identity.device)
+            && header.readU64() == static_cast<uint64_t>(identity.inode) && header.readU64() == static_cast<uint64_t>(identity.size)
+            && header.readU64() == static_cast<uint64_t>(identity.modified);
+        if (!matches) {
+            ::remove(logPath.c_str());
+            return;
+        }
+        logFrames = FrameFormat(changeMagic, header.readU32());
+
+        size_t position = logHeaderSize;
+        uint32_t sequence = 0;
+        while (size - position >= FrameFormat::headerSize) {
+            size_t frame = logFrames.frameAt(data, size, position, sequence);
+            if (frame == 0) {
+                // Only the last change can be torn by a crash, there is never a whole change after it
+                if (logFrames.hasFramesAfter(data, size, position, sequence)) {
+                    throw std::runtime_error(logPath + " is corrupted at byte " + std::to_string(position));
+                }
+                break; // Torn by a crash
+            }
+
+            SnapshotReader in(data + position + FrameFormat::headerSize, frame - FrameFormat::headerSize, version);
+            Change kind = static_cast<Change>(in.readU8());
+            if (kind == Change::Add) {
+                insert(new Flow(in));
+            } else if (kind == Change::Remove) {
+                uint32_t index = in.readU32();
+                if (index >= flowCount) {
+                    throw std::runtime_error(logPath + " is corrupted at byte " + std::to_string(position));
+                }
+                erase(idAt(index));
+            } else {
+                throw std::runtime_error(logPath + " contains an unknown change");
+            }
+            position += frame;
+            sequence++;
+        }
+
+        // The next changes are appended after the last whole one
+        if (position < size && truncate(logPath.c_str(), position) != 0) {
+            throw std::runtime_error("Error writing file: " + logPath);
+        }
+        logSize = position;
+        loggedChanges = sequence;
+    }
+
+public:
+    FlowCatalog(std::string path) : path(path), logPath(path + ".log") {}
+    FlowCatalog(const FlowCatalog&) = delete;
+    FlowCatalog& operator=(const FlowCatalog&) = delete;
+
+
+    // Every loaded flow is freed with its steps
+    ~FlowCatalog() {
+        for (auto& slot : slots) {
+            delete slot.entry.flow;
+        }
+    }
+
+
+    // Maps the snapshot and applies the change log, a missing file just means no flows were saved yet
+    void open() {
+        if (access(path.c_str(), F_OK) != 0) {
+            replayLog();
+            return;
+        }
+
+        snapshot.reset(new MappedFile(path));
+        SnapshotReader header(snapshot->getData(), snapshot->getSize(), version);
+        for (size_t i = 0; i < sizeof(magic); i++) {
+            if (header.readU8() != static_cast<uint8_t>(magic[i])) {
+                throw std::runtime_error(path + " is not a flow snapshot");
+            }
+        }
+        snapshotVersion = header.readU32();
+        if (snapshotVersion < 1 || snapshotVersion > version) {
+            throw std::runtime_error(path + " was saved by an unsupported version");
+        }
+        uint32_t count = header.readU32();
+        uint64_t indexOffset = header.readU64();
+
+        // Only the fixed size index is read, the flow records stay untouched
+        if (indexOffset > snapshot->getSize()) {
+            throw std::runtime_error("The flow snapshot is corrupted");
+        }
+        SnapshotReader index(snapshot->getData() + indexOffset, snapshot->getSize() - indexOffset, version);
+        slots.resize(count);
+        order.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            slots[i].entry.offset = index.readU64();
+            slots[i].entry.size = index.readU64();
+            slots[i].position = i;
+            order[i] = i;
+        }
+        flowCount = count;
+        compactOrder();
+
+        // Records of an older version can't be copied into a new snapshot as they are
+        if (snapshotVersion != version) {
+            for (auto& slot : slots) {
+                load(slot.entry);
+            }
+        }
+        replayLog();
+    }
+
+
+    // Returns the number of flows
+    size_t size() {
+        return flowCount;
+    }
+
+
+    // Returns the handle of the flow listed at the given position
+    FlowId idAt(size_t position) {
+        uint32_t slot = order[positionOf(position)];
+        return FlowId{slot, slots[slot].generation};
+    }
+
+
+    // Returns the flows with the given name
+    std::vector<FlowId> find(const std::string& name) {
+        indexNames();
+        std::vector<FlowId> found;
+        auto range = names.equal_range(name);
+        for (auto match = range.first; match != range.second; match++) {
+            found.push_back(FlowId{match->second, slots[match->second].generation});
+        }
+        return found;
+    }
+
+
+    // Returns a flow, loading it if needed
+    Flow* get(FlowId id) {
+        return load(entryOf(id));
+    }
+
+
+    // Returns the name of a flow without loading it
+    std::string getName(FlowId id) {
+        return nameOf(entryOf(id));
+    }
+
+
+    // Returns the creation date of a flow without loading it
+    std::string getCreatedDate(FlowId id) {
+        Entry& entry = entryOf(id);
+        if (entry.flow != nullptr) {
+            return entry.flow->getCreatedDate();
+        }
+        SnapshotReader in = recordReader(entry);
+        in.readString(); // Skip the name
+        return in.readString();
+    }
+
+
+    // Appends the counters of every flow to the table
+    // Flows that were never loaded are read straight from their records, without creating their steps
+    void collectCounters(AnalyticsTable& table) {
+        for (uint32_t slot : order) {
+            if (slot == hole) {
+                continue;
+            }
+            Entry& entry = slots[slot].entry;
+            if (entry.flow != nullptr) {
+                entry.flow->collectCounters(table);
+                continue;
+            }
+
+            SnapshotReader in = recordReader(entry);
+            table.flowNames.push_back(in.readString());
+            in.skipString(); // Skip the creation date
+            table.flowStarted.push_back(readCounter(in));
+            uint32_t stepCount = in.readU32();
+            table.flowStepCounts.push_back(stepCount);
+            for (uint32_t i = 0; i < stepCount; i++) {
+                StepKind kind = static_cast<StepKind>(in.readU8());
+                table.stepKinds.push_back(static_cast<uint8_t>(kind));
+                for (int screen = 0; screen < 3; screen++) {
+                    table.stepErrors[screen].push_back(readCounter(in));
+                }
+                table.stepSkips.push_back(readCounter(in));
+                for (int parameter = stepParameterCount(kind, snapshotVersion); parameter > 0; parameter--) {
+                    in.skipString();
+                }
+            }
+        }
+    }
+
+
+    // Adds a new flow at the end of the list, returns its handle
+    FlowId add(Flow* flow) {
+        SnapshotWriter change;
+        change.writeU8(static_cast<uint8_t>(Change::Add));
+        flow->save(change);
+        logChange(change);
+        return insert(flow);
+    }
+
+
+    // Removes a flow, the other flows keep their order
+    void remove(FlowId id) {
+        entryOf(id); // Throws if the flow was already removed
+        SnapshotWriter change;
+        change.writeU8(static_cast<uint8_t>(Change::Remove));
+        change.writeU32(countBefore(slots[id.slot].position));
+        logChange(change);
+        erase(id);
+    }
+
+
+    // Makes the flows added and removed since the last save or persist durable
+    // They are appended to the change log, so the cost depends on the changes and not on the number of flows.
+    // Without a snapshot yet, or once the log would outgrow the snapshot, everything is saved instead
+    void persist() {
+        if (changes.getSize() == 0) {
+            return;
+        }
+        if (snapshot == nullptr || logSize + changes.getSize() > std::max<uint64_t>(minLogSize, snapshot->getSize())) {
+            save();
+            return;
+        }
+
+        SnapshotWriter out;
+        int flags = O_WRONLY | O_CREAT | O_APPEND;
+        if (logSize == 0) {
+            // A new log names the snapshot it belongs to
+            const FileIdentity& identity = snapshot->getIdentity();
+            out.writeRaw(logMagic, sizeof(logMagic));
+            out.writeU32(logVersion);
+            out.writeU64(identity.device);
+            out.writeU64(identity.inode);
+            out.writeU64(identity.size);
+            out.writeU64(identity.modified);
+            out.writeU32(logFrames.getKey());
+            flags |= O_TRUNC;
+        }
+        out.writeRaw(changes.getBuffer().data(), changes.getSize());
+
+        int fd = ::open(logPath.c_str(), flags, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Error opening file: " + logPath);
+        }
+        size_t done = 0;
+        while (done < out.getSize()) {
+            ssize_t count = write(fd, out.getBuffer().data() + done, out.getSize() - done);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ::close(fd);
+                throw std::runtime_error("Error writing file: " + logPath);
+            }
+            done += count;
+        }
+        fdatasync(fd);
+        ::close(fd);
+        logSize += out.getSize();
+        loggedChanges += pendingChanges;
+        pendingChanges = 0;
+        changes.clear();
+    }
+
+
+    // Writes all flows to a new snapshot and replaces the old one, the change log is folded into it
+    // Flows that were never loaded are copied over as they are
+    void save() {
+        SnapshotWriter out;
+        out.writeRaw(magic, sizeof(magic));
+        out.writeU32(version);
+        out.writeU32(flowCount);
+        out.writeU64(0); // The index offset is known only at the end
+
+        compactOrder();
+        std::vector<Entry> written;
+        written.reserve(order.size());
+        for (uint32_t slot : order) {
+            written.push_back(slots[slot].entry);
+        }
+        for (auto& entry : written) {
+            uint64_t offset = out.getSize();
+            if (entry.flow != nullptr) {
+                entry.flow->save(out);
+            } else {
+                recordReader(entry); // Makes sure the record is inside the snapshot
+                out.writeRaw(snapshot->getData() + entry.offset, entry.size);
+            }
+            entry.offset = offset;
+            entry.size = out.getSize() - offset;
+        }
+
+        uint64_t indexOffset = out.getSize();
+        for (auto& entry : written) {
+            out.writeU64(entry.offset);
+            out.writeU64(entry.size);
+        }
+        out.patchU64(16, indexOffset);
+
+        replaceFile(path, out.getBuffer());
+
+        // The log belonged to the old snapshot, if deleting it fails it is ignored on open
+        ::remove(logPath.c_str());
+        logSize = 0;
+        loggedChanges = 0;
+        pendingChanges = 0;
+        changes.clear();
+
+        // The records that weren't loaded now live at their new offsets
+        snapshot.reset(new MappedFile(path));
+        snapshotVersion = version;
+        for (size_t i = 0; i < order.size(); i++) {
+            slots[order[i]].entry = written[i];
+        }
+    }
+};
+
+
+// Appends an unsigned number in decimal
+void appendNumber(std::string& out, uint64_t value) {
+    char digits[20];
+    char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    out.append(digits, end);
+}
+
+
+// Appends an OpenMetrics label value, backslashes, quotes and line breaks are escaped
+void appendLabelValue(std::string& out, const std::string& value) {
+    for (char c : value) {
+        if (c == '\\') {
+            out += "\\\\";
+        } else if (c == '"') {
+            out += "\\\"";
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+}
+
+
+// Returns the counters of the table in the OpenMetrics text format, for a node exporter textfile collector
+// Flows are labelled with their position as well as their name, names don't have to be unique
+std::string formatOpenMetrics(const AnalyticsTable& table) {
+    std::string out;
+    out.reserve(128 + table.flowNames.size() * 64 + table.stepKinds.size() * 512);
+
+    // The labels of every step are built once and shared by the three step families
+    std::vector<std::string> stepLabels;
+    stepLabels.reserve(table.stepKinds.size());
+    for (size_t flow = 0, step = 0; flow < table.flowNames.size(); flow++) {
+        for (uint32_t i = 0; i < table.flowStepCounts[flow]; i++, step++) {
+            std::string labels = "{flow_index=\"";
+            appendNumber(labels, flow + 1);
+            labels += "\",flow=\"";
+            appendLabelValue(labels, table.flowNames[flow]);
+            labels += "\",step=\"";
+            appendNumber(labels, i + 1);
+            labels += "\",kind=\"";
+            labels += stepKindName(static_cast<StepKind>(table.stepKinds[step]));
+            labels += "\"";
+            stepLabels.push_back(std::move(labels));
+        }
+    }
+
+    out += "# HELP flow_started Times the flow was started.\n";
+    out += "# TYPE flow_started counter\n";
+    for (size_t flow = 0; flow < table.flowNames.size(); flow++) {
+        out += "flow_started_total{flow_index=\"";
+        appendNumber(out, flow + 1);
+        out += "\",flow=\"";
+        appendLabelValue(out, table.flowNames[flow]);
+        out += "\"} ";
+        appendNumber(out, table.flowStarted[flow]);
+        out += "\n";
+    }
+
+    out += "# HELP flow_step_errors Invalid answers given on a screen of the step.\n";
+    out += "# TYPE flow_step_errors counter\n";
+    for (size_t step = 0; step < stepLabels.size(); step++) {
+        for (int screen = 0; screen < 3; screen++) {
+            out += "flow_step_errors_total";
+            out += stepLabels[step];
+            out += ",screen=\"";
+            appendNumber(out, screen + 1);
+            out += "\"} ";
+            appendNumber(out, table.stepErrors[screen][step]);
+            out += "\n";
+        }
+    }
+
+    out += "# HELP flow_step_skips Times the step was skipped.\n";
+    out += "# TYPE flow_step_skips counter\n";
+    for (size_t step = 0; step < stepLabels.size(); step++) {
+        out += "flow_step_skips_total";
+        out += stepLabels[step];
+        out += "} ";
+        appendNumber(out, table.stepSkips[step]);
+        out += "\n";
+    }
+
+    // The file cache and the background writer are shared by all flows, so their metrics have no labels
+    struct ProcessMetric {
+        const char* name;
+        const char* type;
+        const char* help;
+        uint64_t value;
+    };
+    const ProcessMetric processMetrics[] = {
+        {"flow_file_cache_hits", "counter", "Files found in the file cache.", table.fileCache.hits},
+        {"flow_file_cache_misses", "counter", "Files that had to be mapped.", table.fileCache.misses},
+        {"flow_file_cache_evictions", "counter", "Files dropped from the file cache to stay within its budget.", table.fileCache.evictions},
+        {"flow_file_cache_bytes", "gauge", "Bytes of the files kept in the file cache.", table.fileCache.cachedBytes},
+        {"flow_output_blocks", "counter", "Blocks handed to the background writer.", table.writes.blocks},
+        {"flow_output_bytes", "counter", "Bytes the background writer wrote.", table.writes.bytes},
+        {"flow_output_batches", "counter", "Write calls of the background writer.", table.writes.batches},
+        {"flow_output_stalls", "counter", "Times a report waited for room in the write queue.", table.writes.stalls},
+        {"flow_output_stall_nanoseconds", "counter", "Time reports waited for room in the write queue.", table.writes.stallNanos},
+        {"flow_output_peak_queued_bytes", "gauge", "Most bytes waiting in the write queue at once.", table.writes.peakQueuedBytes},
+        {"flow_output_compressed_input_bytes", "counter", "Bytes of the reports before they were compressed.", table.writes.compressedInput}};
+    for (auto& metric : processMetrics) {
+        bool counter = strcmp(metric.type, "counter") == 0;
+        out += "# HELP ";
+        out += metric.name;
+        out += " ";
+        out += metric.help;
+        out += "\n# TYPE ";
+        out += metric.name;
+        out += " ";
+        out += metric.type;
+        out += "\n";
+        out += metric.name;
+        out += counter ? "_total " : " ";
+        appendNumber(out, metric.value);
+        out += "\n";
+    }
+
+    out += "# EOF\n";
+    return out;
+}
+
+
+// Returns the counters of the table as a columnar file, every column is stored as one contiguous array
+// Layout, all numbers little endian:
+//   "FLOWCOLS", version (u32), flow count (u32), step count (u64)
+//   flow name ends (u64 per flow, end of each name in the name bytes), name bytes
+//   flow started (u64 per flow), flow step count (u32 per flow)
+//   step kind (u8 per step), errors on screen 1, 2 and 3 (u64 per step each), skips (u64 per step)
+std::string formatColumnarAnalytics(const AnalyticsTable& table) {
+    static const char magic[8] = {'F', 'L', 'O', 'W', 'C', 'O', 'L', 'S'};
+    static const uint32_t version = 1;
+
+    SnapshotWriter out;
+    out.writeRaw(magic, sizeof(magic));
+    out.writeU32(version);
+    out.writeU32(table.flowNames.size());
+    out.writeU64(table.stepKinds.size());
+
+    uint64_t nameEnd = 0;
+    for (auto& name : table.flowNames) {
+        nameEnd += name.size();
+        out.writeU64(nameEnd);
+    }
+    for (auto& name : table.flowNames) {
+        out.writeRaw(name.data(), name.size());
+    }
+
+    auto writeColumn = [&out](const auto& column) {
+        out.writeRaw(reinterpret_cast<const char*>(column.data()), column.size() * sizeof(column[0]));
+    };
+    writeColumn(table.flowStarted);
+    writeColumn(table.flowStepCounts);
+    writeColumn(table.stepKinds);
+    for (int screen = 0; screen < 3; screen++) {
+        writeColumn(table.stepErrors[screen]);
+    }
+    writeColumn(table.stepSkips);
+    return std::move(out.getBuffer());
+}
+
+
+#ifdef FLOW_BENCH
+// Benchmark suites, compiled instead of the interactive program when FLOW_BENCH is defined (the flow_bench target):
+//   flow_bench [--suite name]... [--json file] [--list]
+// Every suite prints its numbers and adds the main ones to the report, which --json writes as JSON
+
+
+// The numbers the suites measured, in the order they were measured
+// JSON schema, version 1, new fields may be added but existing ones keep their meaning:
+//   {"schema": "flow_bench", "version": 1, "timestamp": unix seconds, "compiler": string, "threads": hardware threads,
+//    "results": [{"suite": string, "name": string, "value": number, "unit": string}, ...]}
+class BenchReport {
+private:
+    struct Result {
+        std::string suite;
+        std::string name;
+        double value;
+        std::string unit;
+    };
+
+    std::vector<Result> results;
+    std::string suite; // The suite that is running
+
+
+    // Appends a JSON string
+    static void appendString(std::string& out, const std::string& value) {
+        out += '"';
+        for (char c : value) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += c;
+            }
+        }
+        out += '"';
+    }
+
+public:
+    // The results added from now on belong to the given suite
+    void beginSuite(const std::string& name) {
+        suite = name;
+    }
+
+
+    void add(const std::string& name, double value, const std::string& unit) {
+        results.push_back(Result{suite, name, value, unit});
+    }
+
+
+    std::string toJson() const {
+        std::string out = "{\n  \"schema\": \"flow_bench\",\n  \"version\": 1,\n  \"timestamp\": ";
+        out += std::to_string(std::time(nullptr));
+        out += ",\n  \"compiler\": ";
+        appendString(out, __VERSION__);
+        out += ",\n  \"threads\": ";
+        out += std::to_string(std::thread::hardware_concurrency());
+        out += ",\n  \"results\": [";
+        for (size_t i = 0; i < results.size(); i++) {
+            out += i == 0 ? "\n    {\"suite\": " : ",\n    {\"suite\": ";
+            appendString(out, results[i].suite);
+            out += ", \"name\": ";
+            appendString(out, results[i].name);
+            out += ", \"value\": ";
+            // NaN and infinity aren't JSON, a measurement that produced one is written as null
+            out += std::isfinite(results[i].value) ? formatNumber(results[i].value) : "null";
+            out += ", \"unit\": ";
+            appendString(out, results[i].unit);
+            out += "}";
+        }
+        out += "\n  ]\n}\n";
+        return out;
+    }
+};
+
+
+// Builds a flow with the given number of steps, going through every kind of step in turn
+Flow* makeBenchFlow(std::string name, size_t stepCount) {
+    Flow* flow = new Flow(name);
+    for (size_t i = 0; i < stepCount; i++) {
+        switch (i % 9) {
+        case 0: flow->createStep<TitleStep>("title", "subtitle"); break;
+        case 1: flow->createStep<TextStep>("title", "copy"); break;
+        case 2: flow->createStep<TextInput>("description"); break;
+        case 3: flow->createStep<NumberInput<float>>("description"); break;
+        case 4: flow->createStep<CalculusStep<float>>(); break;
+        case 5: flow->createStep<TextFileStep>("description"); break;
+        case 6: flow->createStep<CsvFileStep>("description"); break;
+        case 7: flow->createStep<DisplayStep>("NOFILE"); break;
+        default: flow->createStep<OutputStep>(); break;
+        }
+    }
+    return flow;
+}
+
+
+// The lists a run used to fill, kept between runs like the old globals
+struct LegacyRunLists {
+    std::vector<Step*> steps;
+    std::vector<NumberInput<float>*> numberInputs;
+    std::vector<CalculusStep<float>*> calculusSteps;
+    std::vector<TextFileStep*> textFileSteps;
+    std::vector<CsvFileStep*> csvFileSteps;
+};
+
+
+// How a run sorted the steps before they carried their kind: four casts and a push per step
+void legacyDispatch(const std::vector<Step*>& steps, LegacyRunLists& lists) {
+    lists.steps.clear();
+    lists.numberInputs.clear();
+    lists.calculusSteps.clear();
+    lists.textFileSteps.clear();
+    lists.csvFileSteps.clear();
+
+    for (auto step : steps) {
+        if (dynamic_cast<NumberInput<float>*>(step) != nullptr) {
+            lists.numberInputs.push_back(dynamic_cast<NumberInput<float>*>(step));
+        }
+        if (dynamic_cast<CsvFileStep*>(step) != nullptr) {
+            lists.csvFileSteps.push_back(dynamic_cast<CsvFileStep*>(step));
+        }
+        if (dynamic_cast<TextFileStep*>(step) != nullptr) {
+            lists.textFileSteps.push_back(dynamic_cast<TextFileStep*>(step));
+        }
+        if (dynamic_cast<CalculusStep<float>*>(step) != nullptr) {
+            lists.calculusSteps.push_back(dynamic_cast<CalculusStep<float>*>(step));
+        }
+        lists.steps.push_back(step);
+    }
+}
+
+
+// Compares the per-run cost of sorting the steps with casts against the tagged indexes
+void benchStepDispatch(BenchReport& report) {
+    std::cout << "Step dispatch, per run:\n";
+
+    for (size_t stepCount : {10000, 100000}) {
+        Flow* flow = makeBenchFlow("bench", stepCount);
+        std::vector<Step*> steps = flow->getStep();
+        size_t runs = std::max<size_t>(20, 5000000 / stepCount);
+        volatile size_t sink = 0; // Keeps the compiler from dropping the work
+
+        LegacyRunLists lists;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t run = 0; run < runs; run++) {
+            legacyDispatch(steps, lists);
+            sink = sink + lists.numberInputs.size();
+        }
+        std::chrono::duration<double, std::nano> legacy = std::chrono::steady_clock::now() - start;
+
+        std::vector<std::string> noAnswers;
+        ScriptedIO io(noAnswers);
+        RunContext ctx(io);
+        start = std::chrono::steady_clock::now();
+        for (size_t run = 0; run < runs; run++) {
+            flow->prepare(ctx);
+            for (auto step : steps) {
+                flow->reveal(ctx, step);
+            }
+            sink = sink + ctx.floats.inputs.size();
+        }
+        std::chrono::duration<double, std::nano> tagged = std::chrono::steady_clock::now() - start;
+
+        std::cout << "  " << stepCount << " steps: dynamic_cast " << legacy.count() / runs / 1000 << " us ("
+                  << legacy.count() / runs / stepCount << " ns/step), tagged " << tagged.count() / runs / 1000 << " us ("
+                  << tagged.count() / runs / stepCount << " ns/step)\n";
+        report.add("dynamic_cast_" + std::to_string(stepCount) + "_steps", legacy.count() / runs / stepCount, "ns/step");
+        report.add("tagged_" + std::to_string(stepCount) + "_steps", tagged.count() / runs / stepCount, "ns/step");
+    }
+}
+
+
+// Compares copying a large file into a report line by line with writing it from its mapping
+void benchFileCopy(BenchReport& report) {
+    const std::string source = "bench_copy_source.txt";
+    const std::string target = "bench_copy_target.txt";
+    const size_t targetSize = 256 << 20;
+
+    // Csv-like lines of varying length
+    {
+        OutputWriter writer(source);
+        std::string line;
+        for (size_t written = 0, i = 0; written < targetSize; i++) {
+            line = std::to_string(i) + "," + std::string(i % 64, 'x') + "," + std::to_string(i * 7) + "\n";
+            writer.write(line.data(), line.size());
+            written += line.size();
+        }
+    }
+
+    std::cout << "File copy, " << (targetSize >> 20) << " MiB:\n";
+
+    remove(target.c_str());
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::ifstream in(source);
+        std::ofstream out(target, std::ios::app);
+        std::string line;
+        while (std::getline(in, line)) {
+            out << line << "\n";
+        }
+    }
+    std::chrono::duration<double> lineByLine = std::chrono::steady_clock::now() - start;
+
+    remove(target.c_str());
+    start = std::chrono::steady_clock::now();
+    {
+        OutputWriter writer(target);
+        writer.write(std::make_shared<MappedFile>(source));
+    }
+    std::chrono::duration<double> mapped = std::chrono::steady_clock::now() - start;
+
+    // The whole path an output step takes, addInfoToFile of a text file step ends in addContentsFromFirstFileToSecond
+    Flow* flow = new Flow("copy");
+    flow->createStep<TextFileStep>("description");
+    flow->createStep<OutputStep>();
+    const std::vector<std::string> answers = {"1", source.substr(0, source.size() - 4), "1", target.substr(0, target.size() - 4), "", "y", "1", "n"};
+    remove(target.c_str());
+    start = std::chrono::steady_clock::now();
+    runFlowScripted(flow, answers);
+    std::chrono::duration<double> stepCopy = std::chrono::steady_clock::now() - start;
+    delete flow;
+
+    double megabytes = targetSize / 1048576.0;
+    std::cout << "  getline: " << megabytes / lineByLine.count() << " MiB/s, from the mapping: " << megabytes / mapped.count() << " MiB/s";
+    std::cout << ", text file step: " << megabytes / stepCopy.count() << " MiB/s\n";
+    report.add("getline", megabytes / lineByLine.count(), "MiB/s");
+    report.add("mapped", megabytes / mapped.count(), "MiB/s");
+    report.add("text_file_step", megabytes / stepCopy.count(), "MiB/s");
+
+    remove(source.c_str());
+    remove(target.c_str());
+}
+
+
+// Parses a large csv file shaped like test.csv with the csv engine and with getline and splitting
+void benchCsvParse(BenchReport& report) {
+    const std::string name = "bench_parse.csv";
+    const size_t targetSize = 512 << 20;
+
+    // The rows of test.csv, plus some quoted fields, repeated until the file is big enough
+    {
+        OutputWriter writer(name);
+        const std::string rows[] = {
+            "1,2,3\n",
+            "dfgsdfg,dfgdsg,dfsgsdfg\n",
+            "24,dfsgsdf,123\n",
+            "\"quoted, with comma\",\"say \"\"hi\"\"\",42\n",
+            "3.14,longer text field in the middle of the row,-7\n",
+        };
+        for (size_t written = 0, i = 0; written < targetSize; i++) {
+            const std::string& row = rows[i % 5];
+            writer.write(row.data(), row.size());
+            written += row.size();
+        }
+    }
+
+    std::cout << "Csv parse, " << (targetSize >> 20) << " MiB:\n";
+
+    auto start = std::chrono::steady_clock::now();
+    size_t naiveFields = 0;
+    {
+        std::ifstream in(name);
+        std::string line;
+        std::vector<std::string> fields;
+        while (std::getline(in, line)) {
+            fields.clear();
+            size_t from = 0;
+            size_t comma;
+            while ((comma = line.find(',', from)) != std::string::npos) {
+                fields.push_back(line.substr(from, comma - from));
+                from = comma + 1;
+            }
+            fields.push_back(line.substr(from));
+            naiveFields += fields.size();
+        }
+    }
+    std::chrono::duration<double> naive = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    CsvTable table(name);
+    std::chrono::duration<double> engine = std::chrono::steady_clock::now() - start;
+
+    double megabytes = targetSize / 1048576.0;
+    std::cout << "  getline and split: " << megabytes / naive.count() << " MiB/s (" << naiveFields << " fields)\n";
+    std::cout << "  CsvTable: " << megabytes / engine.count() << " MiB/s (" << table.getRowCount() << " rows, "
+              << table.getColumnCount() << " columns)\n";
+    report.add("getline_split", megabytes / naive.count(), "MiB/s");
+    report.add("csv_table", megabytes / engine.count(), "MiB/s");
+
+    remove(name.c_str());
+}
+
+
+// Compares a calculus step running a compiled expression with one asking for the operands and the operation
+void benchExpression(BenchReport& report) {
+    const size_t runs = 200000;
+    Flow* flow = new Flow("bench");
+    for (int i = 1; i <= 5; i++) {
+        flow->createStep<NumberInput<float>>("description");
+    }
+    CalculusStep<float>* compiled = flow->createStep<CalculusStep<float>>("(n1+n2)*max(n3,n4)/n5");
+    CalculusStep<float>* menus = flow->createStep<CalculusStep<float>>();
+
+    std::cout << "Calculus step, per execution:\n";
+
+    // The number inputs are entered once, 1 to 5, then the calculus step runs over and over
+    std::vector<std::string> inputs;
+    for (int i = 1; i <= 5; i++) {
+        inputs.insert(inputs.end(), {"1", std::to_string(i)});
+    }
+    auto enterInputs = [&](RunContext& ctx) {
+        flow->prepare(ctx);
+        for (auto step : flow->getStep()) {
+            flow->reveal(ctx, step);
+            if (step->getKind() == StepKind::NumberInput) {
+                step->execute(ctx);
+            }
+        }
+    };
+
+    // Run, first operand, second operand, addition
+    std::vector<std::string> answers = inputs;
+    for (size_t run = 0; run < runs; run++) {
+        answers.insert(answers.end(), {"1", "1", "2", "1"});
+    }
+    ScriptedIO io(answers);
+    RunContext ctx(io);
+    enterInputs(ctx);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t run = 0; run < runs; run++) {
+        menus->execute(ctx);
+    }
+    std::chrono::duration<double, std::nano> asked = std::chrono::steady_clock::now() - start;
+
+    std::vector<std::string> runOnly = inputs;
+    runOnly.insert(runOnly.end(), runs, "1");
+    ScriptedIO compiledIO(runOnly);
+    RunContext compiledCtx(compiledIO);
+    enterInputs(compiledCtx);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t run = 0; run < runs; run++) {
+        compiled->execute(compiledCtx);
+    }
+    std::chrono::duration<double, std::nano> expression = std::chrono::steady_clock::now() - start;
+
+    std::cout << "  two operands through the menus: " << asked.count() / runs << " ns, compiled (n1+n2)*max(n3,n4)/n5: "
+              << expression.count() / runs << " ns (result " << compiled->getResult(compiledCtx) << ")\n";
+    report.add("menus", asked.count() / runs, "ns/execute");
+    report.add("compiled_expression", expression.count() / runs, "ns/execute");
+}
+
+
+// Compares reading answers with a regex and the throwing conversions against the from_chars parsers
+void benchInputParsing(BenchReport& report) {
+    const std::vector<std::string> inputs = {"1", "2", "12", "3.5", "-7.25", "abc", "1e3", "+42", "", "99999999999"};
+    const size_t rounds = 20000;
+    volatile double sink = 0; // Keeps the compiler from dropping the work
+
+    std::cout << "Input parsing, per input:\n";
+
+    // How a calculus step checked a menu choice before: a new regex on every call, then stoi
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; round++) {
+        for (auto& input : inputs) {
+            std::regex pattern("^[-+]?[0-9]*\\.?[0-9]+$");
+            if (std::regex_match(input, pattern)) {
+                try {
+                    sink = sink + std::stoi(input);
+                } catch (const std::exception& e) {
+                    sink = sink + 1;
+                }
+            }
+        }
+    }
+    std::chrono::duration<double, std::nano> regexChoice = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; round++) {
+        for (auto& input : inputs) {
+            size_t index;
+            if (parseChoice(input, 100, index) == ParseError::None) {
+                sink = sink + index;
+            }
+        }
+    }
+    std::chrono::duration<double, std::nano> parsedChoice = std::chrono::steady_clock::now() - start;
+
+    // How a number input read its number before: stof, with an exception for every bad answer
+    start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; round++) {
+        for (auto& input : inputs) {
+            try {
+                sink = sink + std::stof(input);
+            } catch (const std::exception& e) {
+                sink = sink + 1;
+            }
+        }
+    }
+    std::chrono::duration<double, std::nano> stofNumber = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; round++) {
+        for (auto& input : inputs) {
+            float value;
+            if (parseNumber(input, value) == ParseError::None) {
+                sink = sink + value;
+            }
+        }
+    }
+    std::chrono::duration<double, std::nano> parsedNumber = std::chrono::steady_clock::now() - start;
+
+    double count = rounds * inputs.size();
+    std::cout << "  menu choice: regex and stoi " << regexChoice.count() / count << " ns, parseChoice " << parsedChoice.count() / count << " ns\n";
+    std::cout << "  number: stof " << stofNumber.count() / count << " ns, parseNumber " << parsedNumber.count() / count << " ns\n";
+    report.add("regex_choice", regexChoice.count() / count, "ns/input");
+    report.add("parse_choice", parsedChoice.count() / count, "ns/input");
+    report.add("stof_number", stofNumber.count() / count, "ns/input");
+    report.add("parse_number", parsedNumber.count() / count, "ns/input");
+}
+
+
+// Cost of one timing point, a clock read and a histogram record, alone and with every thread recording to the same histogram
+void benchLatencyRecording(BenchReport& report) {
+    const size_t rounds = 2000000;
+    LatencyHistogram histogram;
+
+    std::cout << "Latency recording, per timing point:\n";
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t previous = monotonicNanos();
+    for (size_t i = 0; i < rounds; i++) {
+        uint64_t now = monotonicNanos();
+        histogram.record(now - previous);
+        previous = now;
+    }
+    std::chrono::duration<double, std::nano> single = std::chrono::steady_clock::now() - start;
+
+    unsigned threadCount = std::max(2u, std::thread::hardware_concurrency());
+    start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < threadCount; t++) {
+        threads.emplace_back([&histogram, rounds]() {
+            uint64_t previous = monotonicNanos();
+            for (size_t i = 0; i < rounds; i++) {
+                uint64_t now = monotonicNanos();
+                histogram.record(now - previous);
+                previous = now;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double, std::nano> shared = std::chrono::steady_clock::now() - start;
+
+    std::cout << "  one thread " << single.count() / rounds << " ns, " << threadCount << " threads " << shared.count() / rounds << " ns\n";
+    report.add("one_thread", single.count() / rounds, "ns/point");
+    report.add("all_threads", shared.count() / rounds, "ns/point");
+    std::cout << "  p50 " << formatDuration(histogram.percentile(0.5)) << ", p999 " << formatDuration(histogram.percentile(0.999)) << " over " << histogram.count() << " points\n";
+}
+
+
+// Exporting the counters of 100k flows, once while they are still loaded and once straight from their snapshot records
+void benchAnalyticsExport(BenchReport& report) {
+    const std::string path = "bench_export.snapshot";
+    const size_t flowCount = 100000;
+
+    remove(path.c_str());
+    FlowCatalog loaded(path);
+    for (size_t i = 0; i < flowCount; i++) {
+        Flow* flow = new Flow("flow " + std::to_string(i));
+        flow->createStep<TitleStep>("Title", "Subtitle");
+        flow->createStep<TextInput>("Name");
+        flow->createStep<NumberInput<float>>("Amount");
+        flow->createStep<NumberInput<int64_t>>("Count");
+        flow->createStep<CalculusStep<float>>("n1 * 2");
+        loaded.add(flow);
+    }
+    loaded.save();
+
+    FlowCatalog mapped(path);
+    mapped.open();
+
+    std::cout << "Analytics export, " << flowCount << " flows:\n";
+
+    for (FlowCatalog* catalog : {&loaded, &mapped}) {
+        auto start = std::chrono::steady_clock::now();
+        AnalyticsTable table;
+        catalog->collectCounters(table);
+        std::chrono::duration<double, std::milli> collected = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        size_t metricsSize = formatOpenMetrics(table).size();
+        std::chrono::duration<double, std::milli> metrics = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        size_t columnarSize = formatColumnarAnalytics(table).size();
+        std::chrono::duration<double, std::milli> columnar = std::chrono::steady_clock::now() - start;
+
+        std::cout << "  " << (catalog == &loaded ? "loaded" : "snapshot") << ": collect " << collected.count() << " ms";
+        std::cout << ", OpenMetrics " << metrics.count() << " ms (" << (metricsSize >> 20) << " MiB)";
+        std::cout << ", columnar " << columnar.count() << " ms (" << (columnarSize >> 10) << " KiB)\n";
+        std::string source = catalog == &loaded ? "loaded_" : "snapshot_";
+        report.add(source + "collect", collected.count(), "ms");
+        report.add(source + "open_metrics", metrics.count(), "ms");
+        report.add(source + "columnar", columnar.count(), "ms");
+    }
+
+    remove(path.c_str());
+}
+
+
+// Finding, listing and removing flows in a catalog of 100k flows loaded from a snapshot
+void benchFlowRegistry(BenchReport& report) {
+    const std::string path = "bench_registry.snapshot";
+    const size_t flowCount = 100000;
+    const size_t operations = 10000;
+
+    remove(path.c_str());
+    {
+        FlowCatalog created(path);
+        for (size_t i = 0; i < flowCount; i++) {
+            created.add(new Flow("flow " + std::to_string(i)));
+        }
+        created.save();
+    }
+    FlowCatalog catalog(path);
+    catalog.open();
+
+    std::cout << "Flow registry, " << flowCount << " flows:\n";
+
+    auto start = std::chrono::steady_clock::now();
+    catalog.find("flow 0"); // Indexes the names
+    std::chrono::duration<double, std::milli> indexed = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    size_t found = 0;
+    for (size_t i = 0; i < operations; i++) {
+        found += catalog.find("flow " + std::to_string(i * 7 % flowCount)).size();
+    }
+    std::chrono::duration<double, std::nano> lookups = std::chrono::steady_clock::now() - start;
+
+    // A page of the listing from the end of the list
+    start = std::chrono::steady_clock::now();
+    size_t listed = 0;
+    for (size_t i = flowCount - 20; i < flowCount; i++) {
+        listed += catalog.getName(catalog.idAt(i)).size();
+    }
+    std::chrono::duration<double, std::micro> page = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < operations; i++) {
+        catalog.remove(catalog.idAt(0));
+    }
+    std::chrono::duration<double, std::nano> removals = std::chrono::steady_clock::now() - start;
+
+    // Making a removal durable appends it to the change log, saving rewrites every flow
+    catalog.save();
+    const size_t persisted = 100;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < persisted; i++) {
+        catalog.remove(catalog.idAt(catalog.size() / 2));
+        catalog.persist();
+    }
+    std::chrono::duration<double, std::micro> persists = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    catalog.save();
+    std::chrono::duration<double, std::milli> saved = std::chrono::steady_clock::now() - start;
+
+    std::cout << "  name index: " << indexed.count() << " ms, find by name: " << lookups.count() / operations << " ns (" << found << " found)";
+    std::cout << ", last page: " << page.count() << " us, remove the first flow: " << removals.count() / operations << " ns\n";
+    std::cout << "  persist a removal: " << persists.count() / persisted << " us, save everything: " << saved.count() << " ms\n";
+    report.add("index_names", indexed.count(), "ms");
+    report.add("find", lookups.count() / operations, "ns/lookup");
+    report.add("page", page.count(), "us/page");
+    report.add("remove", removals.count() / operations, "ns/remove");
+    report.add("persist_remove", persists.count() / persisted, "us/remove");
+    report.add("save", saved.count(), "ms");
+
+    remove(path.c_str());
+    remove((path + ".log").c_str());
+}
+
+
+// A small flow of typical steps and the answers that take a run through it, one of them rejected
+Flow* makeScriptedBenchFlow(std::string name, std::vector<std::string>& answers) {
+    Flow* flow = new Flow(name);
+    flow->createStep<TitleStep>("Title", "Subtitle");
+    flow->createStep<TextInput>("Name");
+    flow->createStep<NumberInput<int64_t>>("Amount");
+    flow->createStep<NumberInput<int64_t>>("Count");
+    flow->createStep<CalculusStep<int64_t>>("n1 * n2 + 1");
+    answers = {"1", "1", "Ada", "1", "x", "12", "1", "7", "1"};
+    return flow;
+}
+
+
+// Writes a text file of numbered lines of varying length
+void writeBenchTextFile(const std::string& name, size_t lineCount) {
+    OutputWriter writer(name);
+    std::string line;
+    for (size_t i = 0; i < lineCount; i++) {
+        line = "line " + std::to_string(i + 1) + " " + std::string(i % 48, 'x') + "\n";
+        writer.write(line.data(), line.size());
+    }
+}
+
+
+// Whole scripted runs of a small flow through Flow::execute, without the journal
+void benchFlowExecute(BenchReport& report) {
+    const size_t runs = 200000;
+    std::vector<std::string> answers;
+    Flow* flow = makeScriptedBenchFlow("scripted", answers);
+
+    std::cout << "Flow execute, " << runs << " scripted runs of " << flow->getStep().size() << " steps:\n";
+
+    size_t completed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < runs; i++) {
+        completed += runFlowScripted(flow, answers).completed;
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "  " << elapsed.count() / runs << " ns per run, " << runs / elapsed.count() * 1e9 << " runs/s (" << completed << " completed)\n";
+    report.add("run", elapsed.count() / runs, "ns/run");
+    report.add("throughput", runs / elapsed.count() * 1e9, "runs/s");
+
+    // The same flow shared by the runs of every thread, a run only allocates the state block of its steps
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<RunRequest> requests(runs, RunRequest{flow, &answers});
+    start = std::chrono::steady_clock::now();
+    std::vector<RunResult> results = runFlowsParallel(requests, threads);
+    elapsed = std::chrono::steady_clock::now() - start;
+    completed = std::count_if(results.begin(), results.end(), [](const RunResult& result) { return result.completed; });
+
+    std::cout << "  " << threads << " threads sharing the flow: " << runs / elapsed.count() * 1e9 << " runs/s (" << completed
+              << " completed), " << flow->getStateSize() << " bytes of state per run\n";
+    report.add("parallel_throughput", runs / elapsed.count() * 1e9, "runs/s");
+    report.add("state_size", flow->getStateSize(), "bytes/run");
+}
+
+
+// Output step reports that copy a large text file and add the other steps of the flow
+void benchOutputReport(BenchReport& report) {
+    const std::string source = "bench_report_source";
+    const std::string title = "bench_report";
+    const size_t runs = 20;
+    writeBenchTextFile(source + ".txt", 1 << 20);
+
+    Flow* flow = new Flow("report");
+    flow->createStep<TextFileStep>("description");
+    flow->createStep<NumberInput<int64_t>>("Amount");
+    flow->createStep<CalculusStep<int64_t>>("n1 * 2");
+    flow->createStep<OutputStep>();
+    const std::vector<std::string> answers = {"1", source, "1", "42", "1", "1", title, "description", "y", "1", "y", "2", "y", "3", "n"};
+
+    struct stat info;
+    stat((source + ".txt").c_str(), &info);
+    double megabytes = info.st_size / 1048576.0;
+    std::cout << "Output report, " << runs << " reports with a " << (info.st_size >> 20) << " MiB text file:\n";
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < runs; i++) {
+        runFlowScripted(flow, answers);
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "  " << elapsed.count() / runs << " ms per report, " << megabytes * runs / elapsed.count() * 1000 << " MiB/s\n";
+    report.add("report", elapsed.count() / runs, "ms/report");
+    report.add("throughput", megabytes * runs / elapsed.count() * 1000, "MiB/s");
+
+    remove((source + ".txt").c_str());
+    remove((title + ".txt").c_str());
+}
+
+
+// Display steps on a large text file, jumping to its middle and paging through its start
+void benchDisplay(BenchReport& report) {
+    const std::string name = "bench_display";
+    const size_t lineCount = 2000000;
+    const size_t runs = 10;
+    const size_t pages = 1000;
+    writeBenchTextFile(name + ".txt", lineCount);
+
+    Flow* flow = new Flow("display");
+    flow->createStep<TextFileStep>("description");
+    flow->createStep<DisplayStep>();
+
+    std::cout << "Display step, " << lineCount << " lines:\n";
+
+    // Open the file, jump to the middle, show the next page and stop
+    std::vector<std::string> jump = {"1", name, "1", "1", std::to_string(lineCount / 2), "", "q"};
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < runs; i++) {
+        runFlowScripted(flow, jump);
+    }
+    std::chrono::duration<double, std::milli> jumped = std::chrono::steady_clock::now() - start;
+
+    // Open the file and page through its start
+    std::vector<std::string> paging = {"1", name, "1", "1"};
+    paging.insert(paging.end(), pages, "");
+    paging.push_back("q");
+    start = std::chrono::steady_clock::now();
+    runFlowScripted(flow, paging);
+    std::chrono::duration<double, std::nano> paged = std::chrono::steady_clock::now() - start;
+
+    std::cout << "  jump to the middle: " << jumped.count() / runs << " ms, next page: " << paged.count() / pages << " ns\n";
+    report.add("jump_to_middle", jumped.count() / runs, "ms/run");
+    report.add("next_page", paged.count() / pages, "ns/page");
+
+    remove((name + ".txt").c_str());
+}
+
+
+// Looking a file up in the file cache against mapping it again, the way every file step used to
+void benchFileCache(BenchReport& report) {
+    const std::string name = "bench_cache.txt";
+    const size_t lookups = 100000;
+    writeBenchTextFile(name, 100000);
+
+    std::cout << "File cache, " << lookups << " lookups:\n";
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lookups; i++) {
+        MappedFile file(name);
+    }
+    std::chrono::duration<double, std::nano> mapped = std::chrono::steady_clock::now() - start;
+
+    FileCache cache;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lookups; i++) {
+        cache.acquire(name);
+    }
+    std::chrono::duration<double, std::nano> cached = std::chrono::steady_clock::now() - start;
+
+    FileCacheStats stats = cache.getStats();
+    std::cout << "  map every time: " << mapped.count() / lookups << " ns, cache: " << cached.count() / lookups << " ns";
+    std::cout << " (" << stats.hits << " hits, " << stats.misses << " misses)\n";
+    report.add("map", mapped.count() / lookups, "ns/lookup");
+    report.add("cached", cached.count() / lookups, "ns/lookup");
+
+    remove(name.c_str());
+}
+
+
+// Writing a large report through the background writer, how long the writer is held up against how long the
+// file takes to be written, next to writing it right away
+void benchWriteBehind(BenchReport& report) {
+    const std::string target = "bench_write_behind.txt";
+    const size_t targetSize = 256 << 20;
+    std::string line;
+    for (int i = 0; i < 8; i++) {
+        line += std::to_string(i * 7919) + ",";
+    }
+    line += "\n";
+
+    std::cout << "Write behind, " << (targetSize >> 20) << " MiB report:\n";
+
+    remove(target.c_str());
+    auto start = std::chrono::steady_clock::now();
+    {
+        OutputWriter writer(target);
+        for (size_t written = 0; written < targetSize; written += line.size()) {
+            writer.write(line.data(), line.size());
+        }
+    }
+    std::chrono::duration<double, std::milli> direct = std::chrono::steady_clock::now() - start;
+
+    remove(target.c_str());
+    WriteBehind behind;
+    start = std::chrono::steady_clock::now();
+    PendingReport pending;
+    {
+        OutputWriter writer(target, 1 << 20, &behind);
+        for (size_t written = 0; written < targetSize; written += line.size()) {
+            writer.write(line.data(), line.size());
+        }
+        writer.close();
+        pending = writer.getPending(target);
+    }
+    std::chrono::duration<double, std::milli> queued = std::chrono::steady_clock::now() - start;
+    behind.wait(pending.ticket);
+    std::chrono::duration<double, std::milli> written = std::chrono::steady_clock::now() - start;
+
+    WriteBehindStats stats = behind.getStats();
+    std::cout << "  direct: " << direct.count() << " ms, write behind: " << queued.count() << " ms until the writer is done, ";
+    std::cout << written.count() << " ms until the file is written (" << stats.batches << " writes, " << stats.stalls << " stalls)\n";
+    report.add("direct", direct.count(), "ms");
+    report.add("queued", queued.count(), "ms");
+    report.add("written", written.count(), "ms");
+    report.add("stalls", stats.stalls, "count");
+
+    remove(target.c_str());
+}
+
+
+// A report embedding a large file, written as it is and compressed, time until it is on disk and bytes on disk
+void benchCompressedReport(BenchReport& report) {
+    const std::string source = "bench_compress_source.txt";
+    const std::string target = "bench_compress.txt";
+    writeBenchTextFile(source, 8000000);
+
+    struct stat info;
+    stat(source.c_str(), &info);
+    std::cout << "Compressed report, " << (info.st_size >> 20) << " MiB file:\n";
+
+    for (int level : {0, 1, 6}) {
+#ifndef FLOW_HAVE_ZLIB
+        if (level > 0) {
+            std::cout << "  level " << level << ": built without zlib\n";
+            continue;
+        }
+#endif
+        ReportFormat format;
+        format.compression = level;
+        std::string written = level > 0 ? target + ".gz" : target;
+        remove(written.c_str());
+
+        WriteBehind behind;
+        auto start = std::chrono::steady_clock::now();
+        PendingReport pending;
+        {
+            OutputWriter writer(target, 1 << 20, &behind, format);
+            writer.write(FileCache::shared().acquire(source));
+            writer.close();
+            pending = writer.getPending(target);
+        }
+        behind.wait(pending.ticket);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        struct stat output;
+        stat(written.c_str(), &output);
+        std::string name = level > 0 ? "gzip_" + std::to_string(level) : "plain";
+        std::cout << "  " << name << ": " << elapsed.count() << " ms, " << output.st_size << " bytes on disk\n";
+        report.add(name, elapsed.count(), "ms");
+        report.add(name + "_bytes", output.st_size, "bytes");
+        remove(written.c_str());
+    }
+
+    remove(source.c_str());
+}
+
+
+// Cost of journaling a scripted run, the best of a few alternating rounds with and without the journal
+void benchRunJournal(BenchReport& report) {
+    const std::string path = "bench_runs.journal";
+    const size_t runs = 50000;
+    const int rounds = 5;
+
+    std::vector<std::string> answers;
+    Flow* flow = makeScriptedBenchFlow("journaled", answers);
+
+    std::cout << "Run journal, " << runs << " runs:\n";
+
+    remove(path.c_str());
+    double plain = 1e9;
+    double journaled = 1e9;
+    uint64_t stalls = 0;
+    {
+        RunJournal journal(path, std::chrono::milliseconds(100));
+        for (int round = 0; round < rounds; round++) {
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < runs; i++) {
+                runFlowScripted(flow, answers);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            plain = std::min(plain, elapsed.count());
+
+            start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < runs; i++) {
+                runFlowScripted(flow, answers, &journal);
+            }
+            elapsed = std::chrono::steady_clock::now() - start;
+            journaled = std::min(journaled, elapsed.count());
+        }
+        stalls = journal.getStalls();
+    }
+
+    struct stat info;
+    stat(path.c_str(), &info);
+    double added = (journaled - plain) / runs * 1e9;
+    std::cout << "  without journal " << runs / plain << " runs/s, with journal " << runs / journaled << " runs/s, " << info.st_size / (runs * rounds) << " bytes per run\n";
+    std::cout << "  journaling adds " << added << " ns per run, " << added * 50000 / 1e7 << "% of the time at 50k runs/s, "
+              << stalls << " waits for the writer\n";
+    report.add("without_journal", runs / plain, "runs/s");
+    report.add("with_journal", runs / journaled, "runs/s");
+    report.add("journal_cost", added, "ns/run");
+    report.add("journal_stalls", stalls, "count");
+    remove(path.c_str());
+}
+
+// A named group of benchmarks that can be run on its own
+struct BenchSuite {
+    const char* name;
+    void (*run)(BenchReport& report);
+};
+
+
+int main(int argc, char* argv[]) {
+    const BenchSuite suites[] = {
+        {"flow_execute", benchFlowExecute},
+        {"calculus", benchExpression},
+        {"output_report", benchOutputReport},
+        {"file_copy", benchFileCopy},
+        {"display", benchDisplay},
+        {"step_dispatch", benchStepDispatch},
+        {"csv_parse", benchCsvParse},
+        {"input_parsing", benchInputParsing},
+        {"latency", benchLatencyRecording},
+        {"analytics_export", benchAnalyticsExport},
+        {"run_journal", benchRunJournal},
+        {"file_cache", benchFileCache},
+        {"write_behind", benchWriteBehind},
+        {"compressed_report", benchCompressedReport},
+        {"flow_registry", benchFlowRegistry},
+    };
+
+    // Arguments: [--suite name]... [--json file] [--list], without --suite every suite runs
+    std::vector<std::string> chosen;
+    std::string jsonPath;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--suite" && i + 1 < argc) {
+            chosen.push_back(argv[++i]);
+        } else if (argument == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (argument == "--list") {
+            for (auto& suite : suites) {
+                std::cout << suite.name << "\n";
+            }
+            return 0;
+        } else {
+            std::cerr << "Usage: flow_bench [--suite name]... [--json file] [--list]\n";
+            return 1;
+        }
+    }
+    for (auto& name : chosen) {
+        if (std::none_of(std::begin(suites), std::end(suites), [&name](const BenchSuite& suite) { return name == suite.name; })) {
+            std::cerr << "Unknown suite: " << name << "\n";
+            return 1;
+        }
+    }
+
+    BenchReport report;
+    for (auto& suite : suites) {
+        if (chosen.empty() || std::find(chosen.begin(), chosen.end(), suite.name) != chosen.end()) {
+            report.beginSuite(suite.name);
+            suite.run(report);
+        }
+    }
+
+    if (!jsonPath.empty()) {
+        try {
+            replaceFile(jsonPath, report.toJson());
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
         }
-
-        // Close both files
-        inputFile.close();
-        outputFile.close();
     }
+    return 0;
+}
+#elif defined(FLOW_TEST)
+// Checks of the behaviour of the program, compiled instead of the interactive program when FLOW_TEST is defined
+// (the flow_tests target, run by ctest). Every failed check is printed and makes the program exit with 1
 
-public:
-    OutputStep(std::string title, std::string description, std::string previousInfo) : title(title), description(description), previousInfo(previousInfo) {}
-    OutputStep() : title("NO TITLE"), description("NO DESCRIPTION"), previousInfo("NO PREVIOUS INFO") {} // Default constructor
 
+// Counts the checks and remembers the ones that failed
+class TestReport {
+private:
+    std::string test; // Name of the test being run
+    size_t checks = 0;
+    size_t failures = 0;
 
-    // Returns the name of the step
-    std::string getStepName() override {
-        return "Output Step";
+public:
+    // Starts the checks of a test
+    void begin(const std::string& name) {
+        test = name;
     }
 
 
-    // Don't really need this
-    void displayInfoOnScreen() override {
-        return;
+    // Records a check, a failed one is printed with the test it belongs to
+    void check(bool passed, const std::string& what) {
+        checks++;
+        if (!passed) {
+            failures++;
+            std::cout << "FAILED " << test << ": " << what << "\n";
+        }
     }
 
 
-    // Don't really need this
-    void addInfoToFile(std::string name) override {
-        return;
+    // Returns true if every check passed
+    bool passed() {
+        std::cout << checks - failures << " of " << checks << " checks passed\n";
+        return failures == 0;
     }
+};
 
 
-    // Adds the description to the output file
-    void AddDescriptionToFile(std::string name) {
-        std::ofstream file(name, std::ios::app); // Open the file in append mode
-        if (!file.is_open()) {
-            file << "Error opening file: " << name << "\n";
-            return;
-        }
-        
-        file << this->description;
-        file.close();
+// Returns the whole contents of a file, empty if it can't be read
+std::string readTestFile(const std::string& name) {
+    std::ifstream file(name, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+
+// Returns true if calling the function throws
+template <typename Function>
+bool throws(Function function) {
+    try {
+        function();
+    } catch (const std::exception& e) {
+        return true;
     }
+    return false;
+}
 
 
-    // Main function that gets called when the step is executed
-    void execute() override {
-        std::string choice;
-        while (true) {
-            // Display available options
-            std::cout << "---------------------------\n";
-            std::cout << "Running Output Step:\n";
-            std::cout << "1. Run this step\n";
-            std::cout << "2. Skip this step\n";
+// Compiled expressions give the results of the arithmetic of their number type
+void testExpressions(TestReport& test) {
+    Flow flow("expressions");
+    flow.createStep<NumberInput<int64_t>>("a");
+    flow.createStep<NumberInput<int64_t>>("b");
+    CalculusStep<int64_t>* integer = flow.createStep<CalculusStep<int64_t>>("(n1 + n2) * 2 - max(n1, n2)");
+    CalculusStep<int64_t>* chained = flow.createStep<CalculusStep<int64_t>>("c1 / 4 + min(n1, n2)");
+    flow.createStep<NumberInput<Decimal>>("d");
+    CalculusStep<Decimal>* decimal = flow.createStep<CalculusStep<Decimal>>("n1 / 3");
+
+    std::vector<std::string> answers = {"1", "7", "1", "-3", "1", "1", "1", "1", "1"};
+    ScriptedIO io(answers);
+    RunContext ctx(io);
+    flow.execute(ctx);
+    test.check(integer->getResult(ctx) == 1, "(7 + -3) * 2 - 7 is 1, got " + formatNumber(integer->getResult(ctx)));
+    test.check(chained->getResult(ctx) == -3, "1 / 4 + -3 is -3, got " + formatNumber(chained->getResult(ctx)));
+    test.check(decimal->getRunResult(ctx) == "0.3333", "1 / 3 as a decimal is 0.3333, got " + decimal->getRunResult(ctx));
+
+    test.check(throws([] { Expression("1 +"); }), "an expression missing an operand is rejected");
+    test.check(throws([] { Expression("(n1 * 2"); }), "an unclosed parenthesis is rejected");
+    test.check(throws([] { Expression(std::string(100000, '(') + "1" + std::string(100000, ')')); }), "deeply nested parentheses are rejected");
+    test.check(throws([] { Expression(std::string(100000, '-') + "1"); }), "a long run of negations is rejected");
+    test.check(throws([] { Expression(std::string(100000, '(')); }), "a long run of unclosed parentheses is rejected");
+    test.check(!throws([] { Expression(std::string(30, '(') + "-1" + std::string(30, ')')); }), "moderately nested parentheses are accepted");
+    test.check(!Expression("n3 + c1").fits(OperandCounts{2, 1, 0}), "an expression using a missing number input doesn't fit");
+}
 
-            // Get the user's choice
-            std::cout << "Enter your choice: ";
-            getline(std::cin, choice);
 
-            if (choice == "1") { // Run the step
-                std::cout << "---------------------------\n";
+// Answers are read as numbers exactly, anything around the number is an error
+void testParsing(TestReport& test) {
+    int64_t integer = 0;
+    test.check(parseNumber(" +42 ", integer) == ParseError::None && integer == 42, "' +42 ' is 42");
+    test.check(parseNumber("4x2", integer) == ParseError::NotANumber, "'4x2' is not a number");
+    test.check(parseNumber("", integer) == ParseError::Empty, "an empty answer is empty");
+    test.check(parseNumber("9223372036854775808", integer) == ParseError::OutOfRange, "2^63 doesn't fit an integer");
 
-                // Ask for the name of the output file that should be created
-                std::cout << "Enter the title of the output: ";
-                getline(std::cin, title);
+    double real = 0;
+    test.check(parseNumber("2.5e3", real) == ParseError::None && real == 2500, "'2.5e3' is 2500");
 
-                // Ask for the description of the output file
-                std::cout << "Enter the description of the output: ";
-                getline(std::cin, description);
+    Decimal decimal;
+    test.check(parseNumber("-1.2345", decimal) == ParseError::None && decimal.units == -12345, "'-1.2345' is exact");
+    test.check(parseNumber("1.23456", decimal) != ParseError::None, "a fifth decimal is rejected");
+    test.check(formatNumber(Decimal{15000}) == "1.5", "1.5000 is written as 1.5");
 
-                // Set the class member to the respective value
-                this->description = description + "\n";
+    size_t index = 0;
+    test.check(parseChoice("3", 3, index) == ParseError::None && index == 2, "choice 3 of 3 is index 2");
+    test.check(parseChoice("0", 3, index) != ParseError::None, "choice 0 is rejected");
+    test.check(parseChoice("4", 3, index) != ParseError::None, "choice 4 of 3 is rejected");
+}
 
-                // Add the description to the output file
-                AddDescriptionToFile(title + ".txt");
 
-                if (currentFlowSteps.size() == 1) { // If there are no steps in the flow, the output step gets skipped forcefully
-                    std::cout << "There are no previous steps to be added!\n";
-                    std::cout << "Skipping this Output Step...\n";
-                    return;
-                }
+// Builds the flow the replay test journals and replays, the answers make one error and one skip
+Flow* makeReplayFlow(std::vector<std::string>& answers) {
+    Flow* flow = new Flow("replayed");
+    flow->createStep<TitleStep>("Title", "Subtitle");
+    flow->createStep<TextInput>("Name");
+    flow->createStep<NumberInput<int64_t>>("Amount");
+    flow->createStep<CalculusStep<int64_t>>("n1 * 2");
+    answers = {"1", "1", "Ada", "1", "x", "12", "2"};
+    return flow;
+}
 
-                std::string prevChoice = "0";
 
-                // User is asked to add information from previous steps until he choses "n" or "N"
-                while (prevChoice != "y" || prevChoice != "Y" || prevChoice != "n" || prevChoice != "N") {
-                    // Prompt the user to add info from a previous step
-                    std::cout << "---------------------------\n";
-                    std::cout << "Do you want to display a previous step's info? (y/n): ";
-                    getline(std::cin, prevChoice);
+// Replaying the journaled runs of a flow on a copy of it gives the copy the same counters
+void testReplay(TestReport& test) {
+    const std::string path = "test_replay.journal";
+    remove(path.c_str());
 
-                    // Add info from a previous step
-                    if (prevChoice == "y" || prevChoice == "Y") {
-                        std::cout << "---------------------------\n";
-                        std::cout << "Which step do you want to add?\n";
+    std::vector<std::string> answers;
+    std::unique_ptr<Flow> original(makeReplayFlow(answers));
+    {
+        RunJournal journal(path, std::chrono::milliseconds(0));
+        for (int i = 0; i < 5; i++) {
+            test.check(runFlowScripted(original.get(), answers, &journal).completed, "the recorded run completes");
+        }
+    }
 
-                        // Display a list of available TextFileStep objects and let the user choose
-                        for (int i = 0; i < currentFlowSteps.size() - 1; i++) {
-                            std::cout << i + 1 << ". ";
-                            currentFlowSteps[i]->displayInfoOnScreen();
-                        }
+    // Another flow of the same name, journaled after the journal was reopened
+    Flow namesake("replayed");
+    namesake.createStep<TextInput>("Other");
+    std::vector<std::string> namesakeAnswers = {"1", "text"};
+    {
+        RunJournal journal(path, std::chrono::milliseconds(0));
+        test.check(runFlowScripted(&namesake, namesakeAnswers, &journal).completed, "the run of the other flow completes");
+    }
 
-                        // Get the user's choice
-                        std::cout << "\nEnter your choice: ";
-                        std::string stepChoice;
-                        getline(std::cin, stepChoice);
-
-                        try {
-                            // Verify that the user entered a valid number and within acceptable range
-                            if (stoi(stepChoice) >= 1 && stoi(stepChoice) <= currentFlowSteps.size()) {
-                                // Add the info from the chosen step to the output file
-                                currentFlowSteps[stoi(stepChoice) - 1]->addInfoToFile(title + ".txt");
-                            } else { // Invalid choice
-                                std::cout << "Invalid choice! Please try again.\n";
-                                addErrorAtIndex(2); // Error on the second screen
-                            }
-                        } catch (const std::exception& e) {
-                            std::cout << "Invalid choice! Please try again.\n";
-                            addErrorAtIndex(2); // Error on the second screen
-                        }
-                    } else if (prevChoice == "n" || prevChoice == "N") { // The user chose not to add any more info
-                        return;
-                    } else { // Invalid choice
-                        std::cout << "Invalid choice! Please try again.\n";
-                        addErrorAtIndex(1); // Error on the second screen
-                    }
-                }
-            } else if (choice == "2") {
-                std::cout << "Skipping this step...\n";
-                addSkip();
-                break;
-            } else {
-                std::cout << "Invalid choice! Please try again.\n";
-                addErrorAtIndex(0); // Error on the first screen
-            }
+    std::vector<RecordedRun> runs = RunJournal::read(path);
+    test.check(runs.size() == 6, "every run was journaled");
+
+    std::unique_ptr<Flow> copy(makeReplayFlow(answers));
+    test.check(copy->getDefinitionHash() == original->getDefinitionHash() && copy->getDefinitionHash() != namesake.getDefinitionHash(),
+        "flows have the same definition hash only if they have the same steps");
+    ReplayResult replay = replayRuns(copy.get(), runs, 1);
+    test.check(replay.replayed == 5 && replay.diverged == 0, "every run replays without diverging");
+    test.check(replay.otherDefinition == 1, "the run of the other flow with the same name isn't replayed");
+
+    AnalyticsTable recorded;
+    AnalyticsTable replayed;
+    original->collectCounters(recorded);
+    copy->collectCounters(replayed);
+    test.check(recorded.flowStarted == replayed.flowStarted, "the replayed flow was started as often");
+    for (int screen = 0; screen < 3; screen++) {
+        test.check(recorded.stepErrors[screen] == replayed.stepErrors[screen], "the errors on screen " + std::to_string(screen + 1) + " match");
+    }
+    test.check(recorded.stepSkips == replayed.stepSkips, "the skips match");
+    test.check(recorded.stepErrors[1][2] == 5 && recorded.stepSkips[3] == 5, "the error and the skip of every run were counted");
+
+    remove(path.c_str());
+}
+
+
+// A journal cut off at the end loses only its last record, a wrong length anywhere else is reported
+void testCorruptJournal(TestReport& test) {
+    const std::string path = "test_corrupt.journal";
+    remove(path.c_str());
+    std::vector<std::string> answers;
+    std::unique_ptr<Flow> flow(makeReplayFlow(answers));
+    {
+        RunJournal journal(path, std::chrono::milliseconds(0));
+        for (int i = 0; i < 3; i++) {
+            runFlowScripted(flow.get(), answers, &journal);
         }
     }
-};
+    std::string intact = readTestFile(path);
+    std::vector<size_t> frames; // Where every record starts
+    for (size_t position = 16; position < intact.size();) {
+        uint32_t recordSize;
+        memcpy(&recordSize, intact.data() + position + 8, sizeof(recordSize));
+        frames.push_back(position);
+        position += FrameFormat::headerSize + recordSize;
+    }
+    test.check(frames.size() == 3, "the journal holds a record for every run");
+    if (frames.size() != 3) {
+        return;
+    }
+    const uint32_t oversized = 1 << 30;
+
+    replaceFile(path, intact.substr(0, intact.size() - 3));
+    test.check(RunJournal::read(path).size() == 2, "a record cut off at the end is left out");
+
+    std::string torn = intact;
+    memcpy(&torn[frames[2] + 8], &oversized, sizeof(oversized));
+    replaceFile(path, torn);
+    test.check(RunJournal::read(path).size() == 2, "a last record longer than the file is left out");
+
+    std::string corrupted = intact;
+    memcpy(&corrupted[frames[1] + 8], &oversized, sizeof(oversized));
+    replaceFile(path, corrupted);
+    std::string error;
+    try {
+        RunJournal::read(path);
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    test.check(error.find("record 2 at byte " + std::to_string(frames[1])) != std::string::npos,
+        "a wrong length in the middle is reported with where it is");
+    remove(path.c_str());
+}
 
 
-// Flow class
-class Flow {
-private:
-    int started = 0; // Number of times the flow was started
-    std::vector<Step*> steps; // Stores all steps of the flow
-    std::string name; // Name of the flow
-    std::string createdDate; // Date and time when the flow was created
+// An answer that holds the bytes of a frame doesn't make a torn last record look like one in the middle
+void testTornJournalFrame(TestReport& test) {
+    const std::string path = "test_torn.journal";
+    remove(path.c_str());
+    std::vector<std::string> answers;
+    std::unique_ptr<Flow> flow(makeReplayFlow(answers));
+    {
+        RunJournal journal(path, std::chrono::milliseconds(0));
+        for (int i = 0; i < 2; i++) {
+            runFlowScripted(flow.get(), answers, &journal);
+        }
+    }
 
-public:
-    Flow(std::string name) : name(name) { // Constructor
-        // Set the createdDate to the current date and time
-        std::time_t now = std::time(nullptr);
-        createdDate = std::asctime(std::localtime(&now));
+    // A frame numbered after the third record, with the magic of the journal but made without its key
+    std::string header = readTestFile(path);
+    uint32_t magic;
+    memcpy(&magic, header.data() + 16, sizeof(magic));
+    std::string forged;
+    FrameFormat(magic, 2166136261u).append(forged, 3, "forged", 6);
+    std::vector<std::string> forging = answers;
+    forging[2] = forged;
+    {
+        RunJournal journal(path, std::chrono::milliseconds(0));
+        runFlowScripted(flow.get(), forging, &journal);
     }
 
+    // The crash tears the third record right after the forged frame
+    std::string intact = readTestFile(path);
+    size_t cut = intact.find(forged) + forged.size();
+    replaceFile(path, intact.substr(0, cut));
+    std::string error;
+    try {
+        test.check(RunJournal::read(path).size() == 2, "the record holding a forged frame is left out when torn");
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    test.check(error.empty(), "a forged frame in a torn record isn't taken for corruption");
 
-    // Returns the number of times the flow was started
-    int getStarted() {
-        return started;
+    {
+        RunJournal journal(path, std::chrono::milliseconds(0));
+        runFlowScripted(flow.get(), answers, &journal);
     }
+    std::vector<RecordedRun> runs = RunJournal::read(path);
+    test.check(runs.size() == 3 && runs[2].answers == answers, "a run journaled after the torn record reads back");
+    remove(path.c_str());
+}
 
 
-    // Returns the steps of the flow
-    std::vector<Step*> getStep() {
-        return steps;
+// A journal written before runs had a definition hash is still read and appended to in its own version
+void testOldJournal(TestReport& test) {
+    const std::string path = "test_old.journal";
+    SnapshotWriter run;
+    run.writeString("replayed");
+    run.writeU64(0);
+    run.writeU8(static_cast<uint8_t>(JournalEvent::End));
+    run.writeU64(0);
+    run.writeU8(0);
+    SnapshotWriter file;
+    file.writeRaw("FLOWJRNL", 8);
+    file.writeU32(1);
+    file.writeU32(run.getSize());
+    file.writeU32(checksum(run.getBuffer().data(), run.getSize()));
+    file.writeRaw(run.getBuffer().data(), run.getSize());
+    replaceFile(path, file.getBuffer());
+
+    std::vector<std::string> answers;
+    std::unique_ptr<Flow> flow(makeReplayFlow(answers));
+    {
+        RunJournal journal(path, std::chrono::milliseconds(0));
+        test.check(journal.getVersion() == 1, "an old journal keeps its version");
+        runFlowScripted(flow.get(), answers, &journal);
     }
+    std::vector<RecordedRun> runs = RunJournal::read(path);
+    test.check(runs.size() == 2 && runs[0].definition == 0 && runs[1].definition == 0, "the runs of an old journal have no definition hash");
+    test.check(runs.size() == 2 && runs[1].completed && runs[1].answers == answers, "a run appended to an old journal reads back");
+    test.check(replayRuns(flow.get(), runs, 1).otherDefinition == 0, "runs without a definition hash are matched by name");
+    remove(path.c_str());
+}
 
 
-    // Returns the name of the flow
-    std::string getName() {
-        return name;
+// A handle of a removed flow is rejected, also once its slot holds another flow
+void testFlowIds(TestReport& test) {
+    FlowCatalog catalog("test_ids.snapshot");
+    FlowId first = catalog.add(new Flow("first"));
+    FlowId second = catalog.add(new Flow("second"));
+    catalog.remove(first);
+    test.check(throws([&] { catalog.get(first); }), "a removed flow can't be reached");
+
+    FlowId third = catalog.add(new Flow("third"));
+    test.check(third.slot == first.slot, "the freed slot is reused");
+    test.check(throws([&] { catalog.getName(first); }), "the old handle doesn't reach the flow in its slot");
+    test.check(catalog.getName(third) == "third" && catalog.getName(second) == "second", "the other handles still work");
+    test.check(catalog.find("first").empty() && catalog.find("third").size() == 1, "the name index follows the changes");
+}
+
+
+// Returns the names of the flows of a catalog in the order they are listed
+std::vector<std::string> listedNames(FlowCatalog& catalog) {
+    std::vector<std::string> listed;
+    for (size_t i = 0; i < catalog.size(); i++) {
+        listed.push_back(catalog.getName(catalog.idAt(i)));
     }
+    return listed;
+}
 
 
-    // Returns the date and time when the flow was created
-    std::string getCreatedDate() {
-        return createdDate;
+// Removing flows keeps the others in the order they were added, also once the holes were dropped
+void testListingOrder(TestReport& test) {
+    FlowCatalog catalog("test_order.snapshot");
+    std::vector<FlowId> ids;
+    for (int i = 0; i < 100; i++) {
+        ids.push_back(catalog.add(new Flow(std::to_string(i))));
+    }
+    catalog.remove(ids[10]);
+    test.check(catalog.getName(catalog.idAt(10)) == "11" && catalog.getName(catalog.idAt(98)) == "99", "the flows after a removed one move up by one");
+
+    std::vector<std::string> expected;
+    for (int i = 0; i < 100; i++) {
+        if (i % 4 == 3) {
+            expected.push_back(std::to_string(i));
+        } else if (i != 10) {
+            catalog.remove(ids[i]);
+        }
     }
+    catalog.add(new Flow("new"));
+    expected.push_back("new");
+    test.check(listedNames(catalog) == expected, "the remaining flows keep their order");
+}
 
 
-    // If a flow is started it cannot be skipped
-    // So the number of times the flow is started is the number of times it was completed
-    void addStart() {
-        started++;
+// Changes are appended to the log of the snapshot and replayed when it is opened, without rewriting the snapshot
+void testCatalogLog(TestReport& test) {
+    const std::string path = "test_log.snapshot";
+    const std::string log = path + ".log";
+    remove(path.c_str());
+    remove(log.c_str());
+    {
+        FlowCatalog catalog(path);
+        catalog.open();
+        for (const char* name : {"a", "b", "c"}) {
+            catalog.add(new Flow(name));
+        }
+        catalog.persist();
+    }
+    std::string snapshot = readTestFile(path);
+    test.check(!snapshot.empty() && access(log.c_str(), F_OK) != 0, "the first changes are saved as a snapshot");
+
+    {
+        FlowCatalog catalog(path);
+        catalog.open();
+        catalog.remove(catalog.idAt(1));
+        catalog.persist();
+        catalog.add(new Flow("d"));
+        catalog.persist();
+    }
+    test.check(readTestFile(path) == snapshot && access(log.c_str(), F_OK) == 0, "later changes go to the log and leave the snapshot alone");
+
+    std::string logged = readTestFile(log);
+    replaceFile(log, logged.substr(0, logged.size() - 2));
+    {
+        FlowCatalog catalog(path);
+        catalog.open();
+        test.check(listedNames(catalog) == std::vector<std::string>{"a", "c"}, "a change cut off at the end of the log is left out");
+        catalog.add(new Flow("e"));
+        catalog.persist();
+    }
+    {
+        FlowCatalog catalog(path);
+        catalog.open();
+        test.check(listedNames(catalog) == std::vector<std::string>{"a", "c", "e"}, "a change logged after a torn one is replayed");
+        catalog.save();
     }
+    test.check(access(log.c_str(), F_OK) != 0, "saving folds the log into the snapshot");
+
+    // A log left over from before the last save belongs to another snapshot
+    replaceFile(log, logged);
+    {
+        FlowCatalog catalog(path);
+        catalog.open();
+        test.check(listedNames(catalog) == std::vector<std::string>{"a", "c", "e"}, "the log of another snapshot is ignored");
+    }
+    remove(path.c_str());
+    remove(log.c_str());
+}
 
 
-    // Adds a step to the flow
-    void addStep(Step* step) {
-        steps.push_back(step);
+// Counters too large for 32 bits survive a snapshot, whether the flow is loaded or only its record is read
+void testLargeCounters(TestReport& test) {
+    const std::string path = "test_counters.snapshot";
+    const uint64_t large = (uint64_t(1) << 32) + 7;
+    remove(path.c_str());
+    {
+        FlowCatalog catalog(path);
+        Flow* flow = new Flow("counted");
+        flow->createStep<TextInput>("t")->loadCounters(large, large + 1, large + 2, large + 3);
+        catalog.add(flow);
+        catalog.save();
     }
 
+    FlowCatalog reopened(path);
+    reopened.open();
+    AnalyticsTable table;
+    reopened.collectCounters(table);
+    test.check(table.stepErrors[0] == std::vector<uint64_t>{large} && table.stepErrors[2] == std::vector<uint64_t>{large + 2}
+        && table.stepSkips == std::vector<uint64_t>{large + 3}, "the counters read from the record keep all 64 bits");
 
-    // Displays the skips for each step
-    void displaySkips() {
-        std::cout << "---------------------------\n";
-        std::cout << "Skips for each step:\n";
+    Step* step = reopened.get(reopened.idAt(0))->getStep()[0];
+    test.check(step->getErrorsAtIndex(1) == large + 1, "the counters of the loaded flow keep all 64 bits");
+    remove(path.c_str());
+}
 
-        // Loop through all steps of the flow
-        for (size_t i = 0; i < steps.size(); i++) {
-            // Display the name of the step and the number of times it was skipped
-            std::cout << "Step " << i + 1 << ", " << steps[i]->getStepName() << ": Skipped = " << steps[i]->getSkips() << "\n";
-        }
-    }
 
+// The bytes on disk are exactly the bytes written, written right away or in the background
+void testReportBytes(TestReport& test) {
+    const std::string source = "test_report_source.txt";
+    const std::string target = "test_report.txt";
 
-    // Displays the errors for each step on each screen
-    void displayErrors() {
-        std::cout << "---------------------------\n";
-        std::cout << "Errors for each step:\n";
-        
-        for (size_t i = 0; i < steps.size(); i++) {
-            // Displays the name of the step and the number of times it was skipped
-            std::cout << "Step " << i + 1 << ", " << steps[i]->getStepName() << ":\n";
-            steps[i]->displayErrors();
+    std::string large;
+    for (int i = 0; large.size() < (3 << 20); i++) {
+        large += std::to_string(i) + ",line\n";
+    }
+    replaceFile(source, large);
+    std::shared_ptr<MappedFile> mapped = FileCache::shared().acquire(source);
+
+    for (bool background : {false, true}) {
+        remove(target.c_str());
+        WriteBehind behind;
+        PendingReport pending;
+        {
+            OutputWriter writer(target, 1 << 16, background ? &behind : nullptr);
+            writer.out() << "header " << 42 << "\n";
+            writer.write(mapped);
+            writer.write("tail\n", 5);
+            writer.close();
+            pending = writer.getPending(target);
+        }
+        if (background) {
+            behind.wait(pending.ticket);
         }
+        std::string mode = background ? "in the background" : "right away";
+        test.check(!pending.failed->load(), "the report is written " + mode);
+        test.check(readTestFile(target) == "header 42\n" + large + "tail\n", "the report written " + mode + " holds exactly what was written");
     }
 
+    remove(source.c_str());
+    remove(target.c_str());
+}
 
-    // Displays starts and completes
-    void displayStartAndCompletes() {
-        std::cout << "---------------------------\n";
-        std::cout << "Started: " << started << "\n";
-        std::cout << "Completed: " << started << "\n";
+
+// Reports of the same title written in the same run or by parallel runs end up one after the other
+void testSharedReport(TestReport& test) {
+    const std::string source = "test_shared_source";
+    const std::string target = "test_shared";
+    std::string large;
+    for (int i = 0; large.size() < (3 << 20); i++) {
+        large += std::to_string(i) + "\n";
+    }
+    replaceFile(source + ".txt", large);
+
+    // The first report is still being written in the background when the second one opens the file
+    remove((target + ".txt").c_str());
+    Flow flow("shared");
+    flow.createStep<TextFileStep>("d");
+    flow.createStep<OutputStep>();
+    flow.createStep<OutputStep>();
+    std::vector<std::string> answers = {"1", source, "1", target, "first", "y", "1", "n", "1", target, "second", "n"};
+    test.check(runFlowScripted(&flow, answers).completed, "the run with two reports completes");
+    std::string expected = "first\n---------------------------\nTextFile Step:\nText File Description: d\nFile Name: " + source + ".txt\nContents:\n"
+        + large + "second\n";
+    test.check(readTestFile(target + ".txt") == expected, "two reports of the same title in one run are both kept, in order");
+
+    // Parallel runs appending to the same report
+    remove((target + ".txt").c_str());
+    Flow single("single");
+    single.createStep<OutputStep>();
+    std::vector<std::string> singleAnswers = {"1", target, "run"};
+    const size_t runs = 64;
+    std::vector<RunRequest> requests(runs, RunRequest{&single, &singleAnswers});
+    runFlowsParallel(requests, 4);
+    std::string parallel = readTestFile(target + ".txt");
+    std::string everyRun;
+    for (size_t i = 0; i < runs; i++) {
+        everyRun += "run\n";
     }
+    test.check(parallel == everyRun, "every parallel run's report is kept");
 
+    remove((source + ".txt").c_str());
+    remove((target + ".txt").c_str());
+}
 
-    // Displays the average errors for each flow
-    void displayAverageErrors() {
-        int allErrors = 0; // Count all errors from each step
-        for (auto step : steps) {
-            allErrors += step->totalErrors();
+
+#ifdef FLOW_HAVE_ZLIB
+// Returns what a gzip file holds, every member one after the other
+std::string gunzipTestFile(const std::string& name) {
+    std::string packed = readTestFile(name);
+    std::string contents;
+    z_stream stream{};
+    if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+        return "";
+    }
+    stream.next_in = reinterpret_cast<Bytef*>(&packed[0]);
+    stream.avail_in = static_cast<uInt>(packed.size());
+    char chunk[1 << 16];
+    while (stream.avail_in > 0) {
+        stream.next_out = reinterpret_cast<Bytef*>(chunk);
+        stream.avail_out = sizeof(chunk);
+        int result = inflate(&stream, Z_NO_FLUSH);
+        contents.append(chunk, sizeof(chunk) - stream.avail_out);
+        if (result == Z_STREAM_END) {
+            inflateReset(&stream);
+        } else if (result != Z_OK) {
+            contents.clear();
+            break;
         }
+    }
+    inflateEnd(&stream);
+    return contents;
+}
+#endif
 
-        // Display the average errors per flow started
-        std::cout << "---------------------------\n";
-        std::cout << "Average errors per flow: " << (float)allErrors / steps.size() / started << "\n";
+
+// Two rotated reports of the same title, written at the same time, end up one after the other
+// Every part is filled up to the rotation size on disk before the next one starts, and no part is truncated
+void testRotatedReport(TestReport& test) {
+    std::string first;
+    std::string second;
+    for (int i = 0; first.size() < (3 << 20); i++) {
+        first += std::to_string(i) + ",first\n";
+        second += std::to_string(i) + ",second\n";
     }
 
-    
-    // Executes all steps of the flow
-    void execute() {
-        clearCurrentSteps(); // Clears all previous stored teps
-        std::cout << "---------------------------\n";
-        std::cout << "Executing flow: " << name << "\n";
+    std::vector<int> levels = {0};
+#ifdef FLOW_HAVE_ZLIB
+    levels.push_back(6);
+#endif
+    for (int level : levels) {
+        ReportFormat format;
+        format.compression = level;
+        format.rotateBytes = level > 0 ? 16 << 10 : 1 << 20; // The compressed parts are much smaller on disk
+        std::string extension = level > 0 ? ".txt.gz" : ".txt";
+        auto partName = [&extension](int part) {
+            return "test_rotated" + (part > 1 ? "." + std::to_string(part) : std::string()) + extension;
+        };
+        for (int part = 1; access(partName(part).c_str(), F_OK) == 0; part++) {
+            remove(partName(part).c_str());
+        }
 
-        // Loop through all steps of the flow
-        for (auto step : steps) {
-            if (step != nullptr) { // null check
-                if (dynamic_cast<NumberInput<float>*>(step) != nullptr) { // Check if current step is a NumberInputStep
-                    NumberInput<float>* numberStep = dynamic_cast<NumberInput<float>*>(step);
-                    // Add the step to the list of NumberInputStep objects
-                    currentFlowNumberInputs.push_back(numberStep);
-                }
+        // The second writer waits until the first one closed the report
+        WriteBehind behind;
+        std::vector<PendingReport> pending(2);
+        auto writeReport = [&](const std::string& contents, PendingReport& result) {
+            OutputWriter writer("test_rotated.txt", 1 << 16, &behind, format);
+            writer.write(contents.data(), contents.size());
+            writer.close();
+            result = writer.getPending("test_rotated.txt");
+        };
+        std::thread other([&]() { writeReport(second, pending[1]); });
+        writeReport(first, pending[0]);
+        other.join();
+        behind.wait(std::max(pending[0].ticket, pending[1].ticket));
+
+        std::string mode = level > 0 ? "compressed" : "plain";
+        std::string contents;
+        bool filled = true;
+        int parts = 0;
+        for (int part = 1; access(partName(part).c_str(), F_OK) == 0; part++) {
+            struct stat info;
+            stat(partName(part).c_str(), &info);
+            if (access(partName(part + 1).c_str(), F_OK) == 0 && static_cast<uint64_t>(info.st_size) < format.rotateBytes) {
+                filled = false;
+            }
+#ifdef FLOW_HAVE_ZLIB
+            contents += level > 0 ? gunzipTestFile(partName(part)) : readTestFile(partName(part));
+#else
+            contents += readTestFile(partName(part));
+#endif
+            parts++;
+        }
+        test.check(!pending[0].failed->load() && !pending[1].failed->load(), "both " + mode + " rotated reports are written");
+        test.check(parts > 2, "the " + mode + " report was rotated");
+        test.check(filled, "every " + mode + " part but the last one is full on disk");
+        test.check(contents == first + second || contents == second + first, "the " + mode + " rotated parts hold both reports, one after the other");
+        for (int part = 1; part <= parts; part++) {
+            remove(partName(part).c_str());
+        }
+    }
+}
 
-                if (dynamic_cast<CsvFileStep*>(step) != nullptr) { // Check if current step is a CsvFileStep
-                    CsvFileStep* csvFileStep = dynamic_cast<CsvFileStep*>(step);
-                    // Add the step to the list of CsvFileStep objects
-                    currentFlowCsvFileSteps.push_back(csvFileStep);
-                }
 
-                if (dynamic_cast<TextFileStep*>(step) != nullptr) { // Check if current step is a TextFileStep
-                    TextFileStep* textFileStep = dynamic_cast<TextFileStep*>(step);
-                    // Add the step to the list of TextFileStep objects
-                    currentFlowTextFileSteps.push_back(textFileStep);
-                }
+// A named group of checks
+struct TestCase {
+    const char* name;
+    void (*run)(TestReport& test);
+};
 
-                if (dynamic_cast<CalculusStep*>(step) != nullptr) { // Check if current step is a CalculusStep
-                    CalculusStep* calculusStep = dynamic_cast<CalculusStep*>(step);
-                    // Add the step to the list of CalculusStep objects
-                    currentFlowCalculusSteps.push_back(calculusStep);
-                }
 
-                // Add the step to the list of all steps and execute it
-                currentFlowSteps.push_back(step);
-                step->execute();
-            }
+int main(int argc, char* argv[]) {
+    const TestCase tests[] = {
+        {"expressions", testExpressions},
+        {"parsing", testParsing},
+        {"replay", testReplay},
+        {"old_journal", testOldJournal},
+        {"corrupt_journal", testCorruptJournal},
+        {"torn_journal_frame", testTornJournalFrame},
+        {"flow_ids", testFlowIds},
+        {"listing_order", testListingOrder},
+        {"catalog_log", testCatalogLog},
+        {"large_counters", testLargeCounters},
+        {"report_bytes", testReportBytes},
+        {"shared_report", testSharedReport},
+        {"rotated_report", testRotatedReport},
+    };
+
+    TestReport report;
+    for (auto& test : tests) {
+        report.begin(test.name);
+        try {
+            test.run(report);
+        } catch (const std::exception& e) {
+            report.check(false, std::string("threw ") + e.what());
+        }
+    }
+    return report.passed() ? 0 : 1;
+}
+#else
+// Asks which number type a new number step works with, nothing entered means float
+std::string askNumberType() {
+    while (true) {
+        std::cout << "Number type (float, integer, double or decimal, leave empty for float): ";
+        std::string type;
+        getline(std::cin, type);
+        if (type.empty() || type == "float" || type == "integer" || type == "double" || type == "decimal") {
+            return type.empty() ? "float" : type;
         }
+        std::cout << "Invalid type! Please try again.\n";
+    }
+}
 
-        // Display a confirmation that the flow was executed
-        std::cout << "---------------------------\n";
+
+// Lists the flows a page at a time and lets the user choose one by its number or its name
+// Returns false if no flow was chosen
+bool chooseFlow(FlowCatalog& flows, FlowId& id) {
+    const size_t pageSize = 20;
+    size_t pages = std::max<size_t>(1, (flows.size() + pageSize - 1) / pageSize);
+    size_t page = 0;
+    while (true) {
         std::cout << "---------------------------\n";
-        std::cout << "Flow execution is done!\n";
-        std::cout << "Going back to the start page.\n";
-        
-        // To be sure the previous steps are cleared, I clear it again
-        currentFlowNumberInputs.clear();
-    }
-};
+        std::cout << "Available flows:\n";
 
+        // Display the flows of the current page
+        for (size_t i = page * pageSize; i < std::min(flows.size(), (page + 1) * pageSize); i++) {
+            FlowId flow = flows.idAt(i);
+            std::cout << i + 1 << ". " << flows.getName(flow) << ", Created: " << flows.getCreatedDate(flow);
+        }
+        if (pages > 1) {
+            std::cout << "Page " << page + 1 << " of " << pages << ", n for the next page, p for the previous one\n";
+        }
+
+        // Get the user's choice
+        std::cout << "\nEnter your choice (number or name): ";
+        std::string flowChoice;
+        getline(std::cin, flowChoice);
+
+        if (pages > 1 && (flowChoice == "n" || flowChoice == "N")) {
+            page = std::min(page + 1, pages - 1);
+            continue;
+        } else if (pages > 1 && (flowChoice == "p" || flowChoice == "P")) {
+            page = page > 0 ? page - 1 : 0;
+            continue;
+        }
 
-// Clears all previous stored steps
-void clearCurrentSteps() {
-    currentFlowSteps.clear();
-    currentFlowNumberInputs.clear();
-    currentFlowCsvFileSteps.clear();
-    currentFlowTextFileSteps.clear();
-    currentFlowCalculusSteps.clear();
+        // A number chooses by position, anything else by name
+        size_t index;
+        if (parseChoice(flowChoice, flows.size(), index) == ParseError::None) {
+            id = flows.idAt(index);
+            return true;
+        }
+        std::vector<FlowId> found = flows.find(flowChoice);
+        if (found.size() == 1) {
+            id = found[0];
+            return true;
+        } else if (found.size() > 1) {
+            std::cout << "Several flows are named " << flowChoice << ", choose one by its number\n";
+        }
+        return false;
+    }
 }
 
 
-int main() {
-    std::vector<Flow*> flows; // Stores all the flows
+int main(int argc, char* argv[]) {
+    ConsoleIO consoleIO; // Interactive runs read from the keyboard
+
+    // Arguments: [snapshot file] [--journal file] [--journal-sync milliseconds] [--no-journal]
+    //            [--compress-reports level] [--rotate-reports MiB]
+    std::string snapshotPath = "flows.snapshot";
+    std::string journalPath = "flows.journal"; // Every run is journaled unless --no-journal is given
+    int syncMilliseconds = 100; // How long a journaled run can wait until it is synced to disk
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--journal" && i + 1 < argc) {
+            journalPath = argv[++i];
+        } else if (argument == "--journal-sync" && i + 1 < argc) {
+            if (parseNumber(argv[++i], syncMilliseconds) != ParseError::None || syncMilliseconds < 0) {
+                std::cout << "Error: Invalid journal sync interval\n";
+                return 1;
+            }
+        } else if (argument == "--no-journal") {
+            journalPath = "";
+        } else if (argument == "--compress-reports" && i + 1 < argc) {
+            int& level = ReportFormat::current().compression;
+            if (parseNumber(argv[++i], level) != ParseError::None || level < 1 || level > 9) {
+                std::cout << "Error: Invalid compression level, it goes from 1 to 9\n";
+                return 1;
+            }
+#ifndef FLOW_HAVE_ZLIB
+            std::cout << "Error: Reports can't be compressed, the program was built without zlib\n";
+            return 1;
+#endif
+        } else if (argument == "--rotate-reports" && i + 1 < argc) {
+            uint64_t megabytes = 0;
+            if (parseNumber(argv[++i], megabytes) != ParseError::None || megabytes < 1) {
+                std::cout << "Error: Invalid report size\n";
+                return 1;
+            }
+            ReportFormat::current().rotateBytes = megabytes << 20;
+        } else if (argument.rfind("--", 0) == 0) {
+            std::cout << "Error: Unknown option " << argument << "\n";
+            return 1;
+        } else {
+            snapshotPath = argument;
+        }
+    }
+
+    // Stores all the flows
+    FlowCatalog flows(snapshotPath);
+    std::unique_ptr<RunJournal> journal; // Null when runs aren't journaled
+    try {
+        flows.open();
+        if (!journalPath.empty()) {
+            journal.reset(new RunJournal(journalPath, std::chrono::milliseconds(syncMilliseconds)));
+        }
+    } catch (const std::exception& e) {
+        std::cout << "Error: " << e.what() << "\n";
+        return 1;
+    }
 
     while (true) {
         try {
@@ -1492,6 +8493,9 @@ int main() {
             std::cout << "3. Delete a flow\n";
             std::cout << "4. See flow analytics\n";
             std::cout << "5. Exit\n";
+            std::cout << "6. Run a flow from an answer file\n";
+            std::cout << "7. Export flow analytics\n";
+            std::cout << "8. Replay the runs of a flow from a journal\n";
             std::cout << "Enter your choice: ";
             std::string choice;
             getline(std::cin, choice);
@@ -1505,7 +8509,7 @@ int main() {
                 std::string name;
                 getline(std::cin, name);
 
-                Flow* flow = new Flow(name);
+                std::unique_ptr<Flow> flow(new Flow(name)); // Freed with all its steps if creating it fails
                 
                 while (true) {
                     // Display all available steps
@@ -1514,12 +8518,13 @@ int main() {
                     std::cout << "1. Title: title (string), subtitle (string)\n";
                     std::cout << "2. Text: title (string), copy (string)\n";
                     std::cout << "3. TextInput: description (string), text input (string)\n";
-                    std::cout << "4. NumberInput: description (string), number input (string)\n";
-                    std::cout << "5. Calculus: steps (integer), operation (string)\n";
+                    std::cout << "4. NumberInput: type (float, integer, double or decimal), description (string), number input (string)\n";
+                    std::cout << "5. Calculus: type (float, integer, double or decimal), expression (string), or steps (integer) and operation (string)\n";
                     std::cout << "6. TextFile: description(string), filename(string)\n";
                     std::cout << "7. CsvFile: description(string), filename(string)\n";
                     std::cout << "8. Display: step (intger)\n";
                     std::cout << "9. Output: step(integer), filename(string), title (string), description (string)\n";
+                    std::cout << "10. ColumnAggregate: description (string)\n";
                     std::cout << "0. End\n";
                     std::cout << "Enter your choice: ";
 
@@ -1530,146 +8535,250 @@ int main() {
                     if (stepChoice == "0") { // Add the flow to the list of flows and exit the loop
                         // This is basically the end step, didn't need one specifically, so when the user adds the end step
                         // The execution of the flow just stops
-                        flows.push_back(flow);
+                        flows.add(flow.release());
+                        flows.persist();
                         break; // Creating the flow is done, go back to the initial page
 
                     } else if (stepChoice == "1") { // Create and add a new TitleStep
                         // Create the step and add it to the flow
-                        Step* step = new TitleStep();
-                        flow->addStep(step);
+                        flow->createStep<TitleStep>();
                         std::cout << "Title added successfully!\n";
                     } else if (stepChoice == "2") { // Create and add a new TextStep
-                        Step* step = new TextStep();
-                        flow->addStep(step);
+                        flow->createStep<TextStep>();
                         std::cout << "Text added successfully!\n";
                     } else if (stepChoice == "3") { // Create and add a new TextInput
-                        Step* step = new TextInput();
-                        flow->addStep(step);
+                        flow->createStep<TextInput>();
                         std::cout << "TextInput added successfully!\n";
                     } else if (stepChoice == "4") { // Create and add a new NumberInput
-                        Step* step = new NumberInput<float>();
-                        flow->addStep(step);
+                        std::string type = askNumberType();
+                        if (type == "integer") {
+                            flow->createStep<NumberInput<int64_t>>();
+                        } else if (type == "double") {
+                            flow->createStep<NumberInput<double>>();
+                        } else if (type == "decimal") {
+                            flow->createStep<NumberInput<Decimal>>();
+                        } else {
+                            flow->createStep<NumberInput<float>>();
+                        }
                         std::cout << "Number added successfully!\n";
                     } else if (stepChoice == "5") { // Create and add a new CalculusStep
-                        Step* step = new CalculusStep();
-                        flow->addStep(step);
+                        // The expression is checked against the steps of the same type added so far
+                        std::string type = askNumberType();
+                        if (type == "integer") {
+                            flow->createStep<CalculusStep<int64_t>>(flow->getOperandCounts<int64_t>());
+                        } else if (type == "double") {
+                            flow->createStep<CalculusStep<double>>(flow->getOperandCounts<double>());
+                        } else if (type == "decimal") {
+                            flow->createStep<CalculusStep<Decimal>>(flow->getOperandCounts<Decimal>());
+                        } else {
+                            flow->createStep<CalculusStep<float>>(flow->getOperandCounts<float>());
+                        }
                         std::cout << "Calculus added successfully!\n";
                     } else if (stepChoice == "6") { // Create and add a new TextFileStep
-                        Step* step = new TextFileStep();
-                        flow->addStep(step);
+                        flow->createStep<TextFileStep>();
                         std::cout << "TextFile added successfully!\n";
                     } else if (stepChoice == "7") { // Create and add a new CsvFileStep
-                        Step* step = new CsvFileStep();
-                        flow->addStep(step);
+                        flow->createStep<CsvFileStep>();
                         std::cout << "CsvFile added successfully!\n";
                     } else if (stepChoice == "8") { // Create and add a new DisplayStep
-                        Step* step = new DisplayStep();
-                        flow->addStep(step);
+                        flow->createStep<DisplayStep>();
                         std::cout << "Display added successfully!\n";
                     } else if (stepChoice == "9") { // Create and add a new OutputStep
-                        Step* step = new OutputStep();
-                        flow->addStep(step);
+                        flow->createStep<OutputStep>();
                         std::cout << "Output added successfully!\n";
+                    } else if (stepChoice == "10") { // Create and add a new ColumnAggregateStep
+                        flow->createStep<ColumnAggregateStep>();
+                        std::cout << "ColumnAggregate added successfully!\n";
                     } else { // Insteaf of throwing an error, just display a message and ask the user to try again
                         std::cout << "Invalid choice! Please try again.\n";
                     }
                 }
             } else if (choice == "2") { // Execute a flow
-                currentFlowNumberInputs.clear();
-                // Display all available flows
-                std::cout << "---------------------------\n";
-                std::cout << "Available flows:\n";
+                // Let the user choose a flow
+                FlowId id;
+                if (chooseFlow(flows, id)) {
+                    // Execute the flow
+                    flows.get(id)->addStart();
+                    RunContext ctx(consoleIO, journal.get());
+                    flows.get(id)->execute(ctx);
+                } else {
+                    // Invalid choice, go back to the initial page
+                    std::cout << "Error: Invalid Input, going back...\n";
+                    continue;
+                }
+            } else if (choice == "3") { // Delete a flow
+                FlowId id;
+                if (chooseFlow(flows, id)) {
+                    // Delete the flow and show the success message
+                    std::string name = flows.getName(id);
+                    flows.remove(id);
+                    flows.persist();
+                    std::cout << "Flow " << name << " deleted successfully!\n";
+                } else {
+                    // Invalid choice, go back to the initial page
+                    std::cout << "Invalid Input, going back...\n";
+                    continue;
+                }
+            } else if (choice == "4") { // See flow analytics
+                FlowId id;
+                if (chooseFlow(flows, id)) {
+                    Flow* flow = flows.get(id);
 
-                // Display all available flows
-                for (int i = 0; i < flows.size(); i++) {
-                    std::cout << i + 1 << ". " << flows[i]->getName() << ", Created: " << flows[i]->getCreatedDate();
+                    // Display starts and completes counters
+                    flow->displayStartAndCompletes();
+
+                    // Display skips for each step
+                    flow->displaySkips();
+
+                    // Display errors for each step
+                    flow->displayErrors();
+
+                    // Display average errors for each flow
+                    flow->displayAverageErrors();
+
+                    // Display the latencies of the flow and of each step
+                    flow->displayLatencies();
+
+                    // Display the memory taken by the steps
+                    flow->displayStorage();
+
+                    // Display how often the files the steps read were found in the file cache
+                    FileCacheStats cache = FileCache::shared().getStats();
+                    std::cout << "File cache: " << cache.hits << " hits, " << cache.misses << " misses, " << cache.evictions << " evictions, "
+                              << cache.cachedFiles << " files (" << cache.cachedBytes << " bytes) cached\n";
+
+                    // Display how the reports were written in the background
+                    WriteBehindStats writes = WriteBehind::shared().getStats();
+                    std::cout << "Report writer: " << writes.bytes << " bytes in " << writes.blocks << " blocks and " << writes.batches
+                              << " writes, waited for room " << writes.stalls << " times (" << formatDuration(writes.stallNanos)
+                              << "), at most " << writes.peakQueuedBytes << " bytes queued";
+                    if (writes.compressedInput > 0) {
+                        std::cout << ", " << writes.compressedInput << " bytes compressed";
+                    }
+                    std::cout << "\n";
+                } else {
+                    // Invalid choice, go back to the initial page
+                    std::cout << "Invalid Input, going back...\n";
+                    continue;
+                }
+            } else if (choice == "6") { // Run a flow headless, answering from a file
+                FlowId id;
+                if (!chooseFlow(flows, id)) {
+                    std::cout << "Error: Invalid Input, going back...\n";
+                    continue;
                 }
 
-                // Get the user's choice
-                std::cout << "\nEnter your choice: ";
-                std::string flowChoice;
-                getline(std::cin, flowChoice);
+                // Get the answer file, one answer per line
+                std::cout << "Answer file: ";
+                std::string answerFile;
+                getline(std::cin, answerFile);
+
+                // Get how many times the flow should be run
+                std::cout << "Number of runs: ";
+                std::string runsStr;
+                getline(std::cin, runsStr);
+
+                // Get how many runs can execute at the same time
+                std::cout << "Number of threads: ";
+                std::string threadsStr;
+                getline(std::cin, threadsStr);
 
-                // Transform the input into an integer
                 try {
-                    int choice = stoi(flowChoice);
-                    if (choice >= 1 && choice <= flows.size()) {
-                        // Execute the flow
-                        flows[choice - 1]->addStart();
-                        flows[choice - 1]->execute();
-                        clearCurrentSteps();
-                    } else {
-                        // Invalid choice, go back to the initial page
+                    int runs = 0;
+                    int threads = 0;
+                    if (parseNumber(runsStr, runs) != ParseError::None || parseNumber(threadsStr, threads) != ParseError::None || runs < 1 || threads < 1) {
                         throw std::runtime_error("Invalid Input");
                     }
+
+                    std::vector<std::string> answers = loadAnswerScript(answerFile);
+                    std::vector<RunRequest> requests(runs, RunRequest{flows.get(id), &answers});
+
+                    // Run the flow and measure the throughput
+                    int completed = 0;
+                    RunResult lastFailure;
+                    auto start = std::chrono::steady_clock::now();
+                    std::vector<RunResult> results = runFlowsParallel(requests, threads, journal.get());
+                    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+                    for (auto& result : results) {
+                        if (result.completed) {
+                            completed++;
+                        } else {
+                            lastFailure = result;
+                        }
+                    }
+
+                    std::cout << "---------------------------\n";
+                    std::cout << "Runs completed: " << completed << "/" << runs << "\n";
+                    if (completed < runs) {
+                        std::cout << "Last failure: " << lastFailure.error << " (after " << lastFailure.answersUsed << " answers)\n";
+                    }
+                    std::cout << "Elapsed: " << elapsed.count() << "s, " << runs / elapsed.count() << " runs/s\n";
                 } catch (const std::exception& e) {
                     std::cout << "Error: " << e.what() << ", going back...\n";
                     continue;
                 }
-            } else if (choice == "3") { // Delete a flow
+            } else if (choice == "7") { // Export the counters of all flows
                 std::cout << "---------------------------\n";
-                std::cout << "Available flows:\n";
-
-                // Display all available flows
-                for (int i = 0; i < flows.size(); i++) {
-                    std::cout << i + 1 << ". " << flows[i]->getName() << ", Created: " << flows[i]->getCreatedDate();
-                }
-
-                // Get the user's choice
-                std::cout << "\nEnter your choice: ";
-                std::string flowChoice;
-                getline(std::cin, flowChoice);
+                std::cout << "Export name: ";
+                std::string exportName;
+                getline(std::cin, exportName);
 
-                // Transform the input into an integer
                 try {
-                    int choice = stoi(flowChoice);
-                    if (choice >= 1 && choice <= flows.size()) {
-                        // Delete the flow and show the success message
-                        flows.erase(flows.begin() + choice - 1);
-                        std::cout << "Flow " << flows[choice - 1]->getName() << " deleted successfully!\n";
-                    } else {
-                        // Invalid choice, go back to the initial page
-                        std::cout << "Invalid Input, going back...\n";
-                        continue;
-                    }
+                    auto start = std::chrono::steady_clock::now();
+                    AnalyticsTable table;
+                    flows.collectCounters(table);
+                    table.fileCache = FileCache::shared().getStats();
+                    table.writes = WriteBehind::shared().getStats();
+                    replaceFile(exportName + ".prom", formatOpenMetrics(table));
+                    replaceFile(exportName + ".cols", formatColumnarAnalytics(table));
+                    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+                    std::cout << "Exported " << table.flowNames.size() << " flows to " << exportName << ".prom and " << exportName << ".cols";
+                    std::cout << " in " << elapsed.count() << "ms\n";
                 } catch (const std::exception& e) {
                     std::cout << "Error: " << e.what() << ", going back...\n";
                     continue;
                 }
-            } else if (choice == "4") { // See flow analytics
-                std::cout << "---------------------------\n";
-                std::cout << "Available flows:\n";
-
-                // Display all available flows
-                for (int i = 0; i < flows.size(); i++) {
-                    std::cout << i + 1 << ". " << flows[i]->getName() << ", Created: " << flows[i]->getCreatedDate();
+            } else if (choice == "8") { // Replay recorded runs headless
+                FlowId id;
+                if (!chooseFlow(flows, id)) {
+                    std::cout << "Error: Invalid Input, going back...\n";
+                    continue;
                 }
 
-                // Get the user's choice
-                std::cout << "\nEnter your choice: ";
-                std::string flowChoice;
-                getline(std::cin, flowChoice);
+                // Get the journal the runs were recorded in
+                std::cout << "Journal file: ";
+                std::string journalFile;
+                getline(std::cin, journalFile);
 
-                // Transform the input into an integer
-                try {
-                    int choice = stoi(flowChoice);
-                    if (choice >= 1 && choice <= flows.size()) {
-                        // Display starts and completes counters
-                        flows[choice - 1]->displayStartAndCompletes();
+                // Get how many runs can execute at the same time, 1 keeps the recorded order
+                std::cout << "Number of threads: ";
+                std::string threadsStr;
+                getline(std::cin, threadsStr);
 
-                        // Display skips for each step
-                        flows[choice - 1]->displaySkips();
+                try {
+                    int threads = 0;
+                    if (parseNumber(threadsStr, threads) != ParseError::None || threads < 1) {
+                        throw std::runtime_error("Invalid Input");
+                    }
 
-                        // Display errors for each step
-                        flows[choice - 1]->displayErrors();
+                    // The replayed runs aren't journaled again, the journal could be the one being read
+                    std::vector<RecordedRun> runs = RunJournal::read(journalFile);
+                    auto start = std::chrono::steady_clock::now();
+                    ReplayResult replay = replayRuns(flows.get(id), runs, threads);
+                    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
 
-                        // Display average errors for each flow
-                        flows[choice - 1]->displayAverageErrors();
-                    } else {
-                        // Invalid choice, go back to the initial page
-                        std::cout << "Invalid Input, going back...\n";
-                        continue;
+                    std::cout << "---------------------------\n";
+                    std::cout << "Runs replayed: " << replay.replayed << "\n";
+                    std::cout << "Runs diverged: " << replay.diverged << "\n";
+                    if (replay.otherDefinition > 0) {
+                        std::cout << "Runs of another flow with the same name, not replayed: " << replay.otherDefinition << "\n";
                     }
+                    if (replay.diverged > 0) {
+                        std::cout << "First divergence: " << replay.firstDivergence << "\n";
+                    }
+                    std::cout << "Elapsed: " << elapsed.count() << "s, " << replay.replayed / elapsed.count() << " runs/s\n";
                 } catch (const std::exception& e) {
                     std::cout << "Error: " << e.what() << ", going back...\n";
                     continue;
@@ -1678,6 +8787,10 @@ int main() {
                 // Exit the program
                 std::cout << "---------------------------\n";
                 std::cout << "Exiting...\n";
+                flows.save(); // Keeps the counters of this session
+                if (journal && journal->hasFailed()) {
+                    std::cout << "Error: Some runs could not be written to the journal\n";
+                }
                 return 0;
             } else {
                 throw std::runtime_error("Invalid choice!");
@@ -1687,3 +8800,4 @@ int main() {
         }
     }
 }
+#endif